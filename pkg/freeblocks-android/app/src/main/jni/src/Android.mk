@@ -15,14 +15,22 @@ LOCAL_C_INCLUDES := $(LOCAL_PATH)/$(SDL_PATH)/include \
 
 # Add your application source files here...
 LOCAL_SRC_FILES := $(SDL_PATH)/src/main/android/SDL_android_main.c \
+	../../../../../../../src/bitboard.c \
 	../../../../../../../src/block.c \
+	../../../../../../../src/core.c \
 	../../../../../../../src/draw.c \
+	../../../../../../../src/ease.c \
 	../../../../../../../src/easing.c \
 	../../../../../../../src/game.c \
 	../../../../../../../src/game_mode.c \
 	../../../../../../../src/menu.c \
+	../../../../../../../src/moves.c \
+	../../../../../../../src/plane.c \
+	../../../../../../../src/rng.c \
 	../../../../../../../src/sys.c \
 	../../../../../../../src/string.c \
+	../../../../../../../src/workers.c \
+	../../../../../../../src/zobrist.c \
 	../../../../../../../src/main.c
 
 LOCAL_SHARED_LIBRARIES := SDL2 SDL2_image SDL2_mixer SDL2_ttf
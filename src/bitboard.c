@@ -0,0 +1,211 @@
+/*
+    FreeBlocks -  A simple puzzle game, similar to Tetris Attack
+    Copyright (C) 2012-2017 Justin Jacobs
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "bitboard.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+static int bitboardCountTrailingZeros(BitWord w) {
+#if defined(__GNUC__)
+    return __builtin_ctzll(w);
+#elif defined(_MSC_VER) && defined(_WIN64)
+    unsigned long index;
+    _BitScanForward64(&index, w);
+    return (int)index;
+#else
+    int n = 0;
+    while (!(w & 1)) {
+        w >>= 1;
+        n++;
+    }
+    return n;
+#endif
+}
+
+static int bitboardRow(const Bitboard *bitboard, int i) {
+    // offset of the first word of row i in each mask
+    int r = i + bitboard->base;
+    if (r >= bitboard->rows) r -= bitboard->rows;
+    return r*bitboard->words;
+}
+
+// Shift a row towards column 0, so bit j of dest is bit j+n of src
+static void bitboardShiftDown(int words, BitWord* dest, const BitWord* src, int n) {
+    for (int w=0; w<words; w++) {
+        dest[w] = src[w] >> n;
+        if (w+1 < words)
+            dest[w] |= src[w+1] << (BITBOARD_WORD_BITS - n);
+    }
+}
+
+// Shift a row away from column 0, so bit j of dest is bit j-n of src
+static void bitboardShiftUp(int words, BitWord* dest, const BitWord* src, int n) {
+    for (int w=words-1; w>=0; w--) {
+        dest[w] = src[w] << n;
+        if (w > 0)
+            dest[w] |= src[w-1] >> (BITBOARD_WORD_BITS - n);
+    }
+}
+
+// Cells in row i that can match a cell of the same color to their right
+static void bitboardEqualRight(const Bitboard *bitboard, int i, BitWord* out) {
+    int words = bitboard->words;
+    const BitWord* matchable = bitboard->matchable + bitboardRow(bitboard, i);
+    BitWord m[BITBOARD_MAX_WORDS] = {0};
+    BitWord shifted[BITBOARD_MAX_WORDS];
+
+    memset(out, 0, sizeof(BitWord)*words);
+    for (int c=0; c<BITBOARD_MAX_COLORS; c++) {
+        const BitWord* color = bitboard->color[c] + bitboardRow(bitboard, i);
+        for (int w=0; w<words; w++)
+            m[w] = color[w] & matchable[w];
+        bitboardShiftDown(words, shifted, m, 1);
+        for (int w=0; w<words; w++)
+            out[w] |= m[w] & shifted[w];
+    }
+}
+
+// Cells in row i that can match the cell of the same color below them
+static void bitboardEqualDown(const Bitboard *bitboard, int i, BitWord* out) {
+    int words = bitboard->words;
+    int r1 = bitboardRow(bitboard, i);
+    int r2 = bitboardRow(bitboard, i+1);
+    const BitWord* m1 = bitboard->matchable + r1;
+    const BitWord* m2 = bitboard->matchable + r2;
+
+    memset(out, 0, sizeof(BitWord)*words);
+    for (int c=0; c<BITBOARD_MAX_COLORS; c++) {
+        const BitWord* c1 = bitboard->color[c] + r1;
+        const BitWord* c2 = bitboard->color[c] + r2;
+        for (int w=0; w<words; w++)
+            out[w] |= c1[w] & m1[w] & c2[w] & m2[w];
+    }
+}
+
+void bitboardInit(Bitboard *bitboard, int rows, int cols) {
+    bitboardCleanup(bitboard);
+
+    bitboard->rows = rows;
+    bitboard->words = (cols + BITBOARD_WORD_BITS - 1) / BITBOARD_WORD_BITS;
+    bitboard->base = 0;
+
+    size_t size = sizeof(BitWord) * rows * bitboard->words;
+    bitboard->alive = calloc(1, size);
+    bitboard->matchable = calloc(1, size);
+    for (int c=0; c<BITBOARD_MAX_COLORS; c++) {
+        bitboard->color[c] = calloc(1, size);
+    }
+}
+
+void bitboardCleanup(Bitboard *bitboard) {
+    free(bitboard->alive);
+    bitboard->alive = NULL;
+    free(bitboard->matchable);
+    bitboard->matchable = NULL;
+    for (int c=0; c<BITBOARD_MAX_COLORS; c++) {
+        free(bitboard->color[c]);
+        bitboard->color[c] = NULL;
+    }
+}
+
+void bitboardRotate(Bitboard *bitboard) {
+    // row 0 becomes the last row, and every other row moves up by one
+    bitboard->base = (bitboard->base + 1) % bitboard->rows;
+}
+
+bool bitboardSetCell(Bitboard *bitboard, int i, int j, bool alive, int color, bool matchable) {
+    // returns true if the match state of the cell actually changed
+    int w = bitboardRow(bitboard, i) + j/BITBOARD_WORD_BITS;
+    BitWord bit = (BitWord)1 << (j % BITBOARD_WORD_BITS);
+    BitWord changed = 0;
+
+    BitWord old = bitboard->alive[w];
+    if (alive) bitboard->alive[w] |= bit;
+    else bitboard->alive[w] &= ~bit;
+    changed |= old ^ bitboard->alive[w];
+
+    old = bitboard->matchable[w];
+    if (matchable) bitboard->matchable[w] |= bit;
+    else bitboard->matchable[w] &= ~bit;
+    changed |= old ^ bitboard->matchable[w];
+
+    for (int c=0; c<BITBOARD_MAX_COLORS; c++) {
+        BitWord* mask = bitboard->color[c];
+        old = mask[w];
+        if (alive && c == color) mask[w] |= bit;
+        else mask[w] &= ~bit;
+        changed |= old ^ mask[w];
+    }
+
+    return changed != 0;
+}
+
+bool bitboardMatchRow(const Bitboard *bitboard, int i, int v_begin, int v_end, BitWord* out) {
+    // Cells in row i that belong to a horizontal run of 3 or more, or to a
+    // vertical run of 3 or more that lies entirely within [v_begin, v_end)
+    BitWord eq[BITBOARD_MAX_WORDS];
+    BitWord eq_next[BITBOARD_MAX_WORDS];
+    BitWord runs[BITBOARD_MAX_WORDS] = {0};
+    BitWord shifted[BITBOARD_MAX_WORDS];
+    int words = bitboard->words;
+
+    // horizontal: j == j+1 and j+1 == j+2 starts a run, which covers j..j+2
+    bitboardEqualRight(bitboard, i, eq);
+    bitboardShiftDown(words, shifted, eq, 1);
+    for (int w=0; w<words; w++)
+        runs[w] = eq[w] & shifted[w];
+
+    memcpy(out, runs, sizeof(BitWord)*words);
+    bitboardShiftUp(words, shifted, runs, 1);
+    for (int w=0; w<words; w++)
+        out[w] |= shifted[w];
+    bitboardShiftUp(words, shifted, runs, 2);
+    for (int w=0; w<words; w++)
+        out[w] |= shifted[w];
+
+    // vertical: a run starting at row s covers s..s+2, so check s = i-2..i
+    for (int s=i-2; s<=i; s++) {
+        if (s < v_begin || s+2 >= v_end)
+            continue;
+        bitboardEqualDown(bitboard, s, eq);
+        bitboardEqualDown(bitboard, s+1, eq_next);
+        for (int w=0; w<words; w++)
+            out[w] |= eq[w] & eq_next[w];
+    }
+
+    for (int w=0; w<words; w++)
+        if (out[w]) return true;
+    return false;
+}
+
+int bitboardNextBit(const Bitboard *bitboard, const BitWord* row, int j) {
+    // Find the first set column >= j, or -1 if there isn't one
+    for (int w=j/BITBOARD_WORD_BITS; w<bitboard->words; w++) {
+        BitWord word = row[w];
+        if (w == j/BITBOARD_WORD_BITS)
+            word &= ~(BitWord)0 << (j % BITBOARD_WORD_BITS);
+        if (word)
+            return w*BITBOARD_WORD_BITS + bitboardCountTrailingZeros(word);
+    }
+    return -1;
+}
@@ -0,0 +1,53 @@
+/*
+    FreeBlocks -  A simple puzzle game, similar to Tetris Attack
+    Copyright (C) 2012-2017 Justin Jacobs
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BITBOARD_H
+#define BITBOARD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// One bit per column, so a board row is a handful of words
+typedef uint64_t BitWord;
+
+#define BITBOARD_WORD_BITS 64
+#define BITBOARD_MAX_COLS 256
+#define BITBOARD_MAX_WORDS (BITBOARD_MAX_COLS / BITBOARD_WORD_BITS)
+#define BITBOARD_MAX_COLORS 8
+
+typedef struct Bitboard{
+    int rows;
+    int words;
+
+    // Rows are stored as a ring, and row 0 is physical row base
+    int base;
+
+    // Each mask is one row of words words per board row
+    BitWord *alive;
+    BitWord *matchable;
+    BitWord *color[BITBOARD_MAX_COLORS];
+}Bitboard;
+
+void bitboardInit(Bitboard *bitboard, int rows, int cols);
+void bitboardCleanup(Bitboard *bitboard);
+void bitboardRotate(Bitboard *bitboard);
+bool bitboardSetCell(Bitboard *bitboard, int i, int j, bool alive, int color, bool matchable);
+bool bitboardMatchRow(const Bitboard *bitboard, int i, int v_begin, int v_end, BitWord* out);
+int bitboardNextBit(const Bitboard *bitboard, const BitWord* row, int j);
+
+#endif
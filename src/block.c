@@ -15,107 +15,284 @@
     You should have received a copy of the GNU General Public License
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
+#include <limits.h>
 #include <math.h>
+#include <stdlib.h>
+#include <string.h>
 
+#include "bitboard.h"
 #include "block.h"
+#include "core.h"
 #include "game_mode.h"
-#include "sys.h"
+#include "moves.h"
+#include "plane.h"
+#include "rng.h"
+#include "workers.h"
+#include "zobrist.h"
 
 const int POINTS_PER_BLOCK = 10;
 const int POINTS_PER_BUMP = 5;
 const int POINTS_PER_COMBO_BLOCK = 15;
 
-int speed_init = 1;
-Block **blocks = NULL;
-
-int blockRand() {
-    return rand() % NUM_BLOCKS;
-}
-
-void blockSet(int i, int j, bool alive, int color) {
-    blocks[i][j].x = j*BLOCK_SIZE;
-    blocks[i][j].y = i*BLOCK_SIZE;
-    blocks[i][j].start_col = j;
-    blocks[i][j].start_row = i;
-    blocks[i][j].dest_col = j;
-    blocks[i][j].dest_row = i;
-    blocks[i][j].alive = alive;
-    blocks[i][j].color = color;
-    blocks[i][j].matched = false;
-    blocks[i][j].clear_timer = 0;
-    blocks[i][j].frame = -1;
-    blocks[i][j].moving = false;
-    blocks[i][j].move_counter = 0;
-    blocks[i][j].move_counter_max = 1;
-    blocks[i][j].ease_func = NULL;
-    blocks[i][j].return_row = -1;
-    blocks[i][j].return_col = -1;
-    blocks[i][j].sound_after_move = false;
-}
-
-void blockClear(int i, int j) {
-    blocks[i][j].alive = false;
-    blocks[i][j].color = 1;
-    blocks[i][j].matched = false;
-    blocks[i][j].clear_timer = 0;
-    blocks[i][j].frame = -1;
-    blocks[i][j].moving = false;
-    blocks[i][j].move_counter = 0;
-    blocks[i][j].move_counter_max = 1;
-    blocks[i][j].ease_func = NULL;
-    blocks[i][j].return_row = -1;
-    blocks[i][j].return_col = -1;
-    blocks[i][j].sound_after_move = false;
-}
-
-void blockSwitch(int i, int j, int k, int l, bool animate, bool sound_after_move, AHEasingFunction ease_func) {
-    if (i < 0 || i >= ROWS || j < 0 || j >= COLS || k < 0 || k >= ROWS || l < 0 || l >= COLS) return;
-    if (blocks[i][j].matched || blocks[k][l].matched) return;
-
-    int b1_color = blocks[i][j].color;
-    int b1_alive = blocks[i][j].alive;
-    int b2_color = blocks[k][l].color;
-    int b2_alive = blocks[k][l].alive;
-
-    blocks[i][j].color = b2_color;
-    blocks[i][j].alive = b2_alive;
-    blocks[k][l].color = b1_color;
-    blocks[k][l].alive = b1_alive;
+int blockRand(Board *board) {
+    return rngRange(&board->rng, board->num_blocks);
+}
+
+int blockRandRange(Board *board, int n) {
+    return rngRange(&board->rng, n);
+}
+
+int blockRandExcept(Board *board, int a, int b) {
+    // Pick one of the colors other than a and b (either can be -1) with a
+    // single draw, by counting through the colors that are left
+    int allowed = board->num_blocks;
+    if (a >= 0 && a < board->num_blocks) allowed--;
+    if (b >= 0 && b < board->num_blocks && b != a) allowed--;
+    if (allowed <= 0) return blockRand(board);
+
+    int n = rngRange(&board->rng, allowed);
+    for (int c=0; c<board->num_blocks; c++) {
+        if (c == a || c == b) continue;
+        if (n-- == 0) return c;
+    }
+    return blockRand(board);
+}
+
+static bool blockCanMatch(Board *board, int i, int j) {
+    return board->blocks[i][j].color != -1 && board->blocks[i][j].alive &&
+        board->blocks[i][j].clear_timer == 0 && board->blocks[i][j].frame <= 0;
+}
+
+// Two blocks the kernels are trying a switch on, without moving them
+typedef struct BlockSwap{
+    int i, j, k, l;
+}BlockSwap;
+
+static int blockSwapKey(Board *board, const BlockSwap* swap, int i, int j) {
+    // The color (i,j) could match as with the switch made, or -1. A switch
+    // moves the color and alive flag, but the clear state stays with the cell.
+    const Block* slot = &board->blocks[i][j];
+    const Block* block = slot;
+    if (i == swap->i && j == swap->j) block = &board->blocks[swap->k][swap->l];
+    else if (i == swap->k && j == swap->l) block = &board->blocks[swap->i][swap->j];
+
+    if (slot->clear_timer != 0 || slot->frame > 0 || !block->alive || block->color == -1) return -1;
+    return block->color;
+}
+
+// Boards with at least this many cells share their scans between threads,
+// in bands of at least this many rows or columns
+#define PARALLEL_CELLS 4096
+#define PARALLEL_BAND 16
+
+// Rows queued for blockAddLayer(). Queued row n starts at
+// row_queue[((row_queue_head + n) % ROW_QUEUE_SIZE) * cols].
+#define ROW_QUEUE_SIZE 8
+
+static void indexSetInit(IndexSet* set, int size) {
+    set->items = malloc(sizeof(int)*size);
+    set->member = calloc(size, sizeof(bool));
+    set->count = 0;
+}
+
+static void indexSetFree(IndexSet* set) {
+    free(set->items);
+    set->items = NULL;
+    free(set->member);
+    set->member = NULL;
+    set->count = 0;
+}
+
+static void indexSetAdd(IndexSet* set, int index) {
+    if (!set->member[index]) {
+        set->member[index] = true;
+        set->items[set->count++] = index;
+    }
+}
+
+// The sets store physical rows and cells, so they survive row rotation
+static int blockPhysicalRow(Board *board, int i) {
+    return (i + board->row_base) % board->rows;
+}
+
+static int blockLogicalRow(Board *board, int physical_row) {
+    return (physical_row - board->row_base + board->rows) % board->rows;
+}
+
+static int blockLogicalCell(Board *board, int physical_cell) {
+    return blockLogicalRow(board, physical_cell / board->cols)*board->cols + physical_cell % board->cols;
+}
+
+static void blockColumnSync(Board *board, int i, int j) {
+    int top = board->rows - board->column_height[j];
+    if (!board->blocks[i][j].alive && i >= top) {
+        board->column_height[j] = board->rows-1 - i;
+    }
+    else if (board->blocks[i][j].alive && i == top-1) {
+        // the gap is filled, so the stack now reaches any blocks above it
+        while (top > 0 && board->blocks[top-1][j].alive) top--;
+        board->column_height[j] = board->rows - top;
+    }
+}
+
+static void blockSync(Board *board, int i, int j) {
+    board->version++;
+
+    // keep the row masks up to date with this cell's match state
+    if (bitboardSetCell(&board->bitboard, i, j, board->blocks[i][j].alive, board->blocks[i][j].color, blockCanMatch(board, i, j)))
+        indexSetAdd(&board->dirty_rows, blockPhysicalRow(board, i));
+    // only the generic kernels read the plane
+    if (board->kernels == &block_kernels_generic)
+        planeSetCell(&board->plane, i, j, blockCanMatch(board, i, j) ? board->blocks[i][j].color : -1);
+    movesUpdateCell(board, i, j);
+
+    int content = board->blocks[i][j].alive ? board->blocks[i][j].color : -1;
+    int row = blockPhysicalRow(board, i);
+    signed char* hashed = &board->hash_content[row*board->cols + j];
+    if (*hashed != content) {
+        uint64_t* row_hash = &board->row_hash[row];
+        board->hash ^= zobristRow(i, *row_hash);
+        *row_hash ^= zobristCell(j, *hashed) ^ zobristCell(j, content);
+        board->hash ^= zobristRow(i, *row_hash);
+        *hashed = content;
+    }
+
+    blockColumnSync(board, i, j);
+}
+
+static void blockActivate(Board *board, int i, int j) {
+    indexSetAdd(&board->active_cells, blockPhysicalRow(board, i)*board->cols + j);
+}
+
+static void blockBeginGroup(Board *board, int color, MatchShape shape, int length) {
+    MatchGroup* group = &board->match_groups[board->match_group_count];
+    group->color = color;
+    group->shape = shape;
+    group->length = length;
+    group->first_cell = board->match_cell_count;
+    group->cell_count = 0;
+}
+
+static void blockEndGroup(Board *board) {
+    // groups that didn't match anything new aren't kept
+    if (board->match_groups[board->match_group_count].cell_count > 0)
+        board->match_group_count++;
+}
+
+static void blockMarkMatched(Board *board, int i, int j) {
+    board->blocks[i][j].matched = true;
+
+    // a block is only listed again if it was reset and matched a second time
+    // before being cleared, so running out of room is next to impossible
+    if (board->match_cell_count < board->rows*board->cols) {
+        board->match_cells[board->match_cell_count++] = blockPhysicalRow(board, i)*board->cols + j;
+        board->match_groups[board->match_group_count].cell_count++;
+    }
+    else {
+        board->match_overflow = true;
+    }
+
+    blockSync(board, i,j);
+    blockActivate(board, i,j);
+}
+
+void blockSet(Board *board, int i, int j, bool alive, int color) {
+    board->block_anims[i][j].offset_x = 0;
+    board->block_anims[i][j].offset_y = 0;
+    board->block_anims[i][j].from_col = 0;
+    board->block_anims[i][j].from_row = 0;
+    board->blocks[i][j].alive = alive;
+    board->blocks[i][j].color = color;
+    board->blocks[i][j].matched = false;
+    board->blocks[i][j].clear_timer = 0;
+    board->blocks[i][j].frame = -1;
+    board->block_anims[i][j].moving = false;
+    board->block_anims[i][j].move_counter = 0;
+    board->block_anims[i][j].move_counter_max = 1;
+    board->block_anims[i][j].ease = EASE_LINEAR;
+    board->block_anims[i][j].returning = false;
+    board->block_anims[i][j].sound_after_move = false;
+    blockSync(board, i,j);
+}
+
+void blockClear(Board *board, int i, int j) {
+    board->blocks[i][j].alive = false;
+    board->blocks[i][j].color = 1;
+    board->blocks[i][j].matched = false;
+    board->blocks[i][j].clear_timer = 0;
+    board->blocks[i][j].frame = -1;
+    board->block_anims[i][j].moving = false;
+    board->block_anims[i][j].move_counter = 0;
+    board->block_anims[i][j].move_counter_max = 1;
+    board->block_anims[i][j].ease = EASE_LINEAR;
+    board->block_anims[i][j].returning = false;
+    board->block_anims[i][j].sound_after_move = false;
+    blockSync(board, i,j);
+}
+
+void blockSetAlive(Board *board, int i, int j, bool alive, int color) {
+    // change only the contents of a cell, leaving its animation alone
+    board->blocks[i][j].alive = alive;
+    board->blocks[i][j].color = color;
+    blockSync(board, i,j);
+}
+
+void blockSwitch(Board *board, int i, int j, int k, int l, bool animate, bool sound_after_move, EaseType ease) {
+    if (i < 0 || i >= board->rows || j < 0 || j >= board->cols || k < 0 || k >= board->rows || l < 0 || l >= board->cols) return;
+    if (board->blocks[i][j].matched || board->blocks[k][l].matched) return;
+
+    int b1_color = board->blocks[i][j].color;
+    int b1_alive = board->blocks[i][j].alive;
+    int b2_color = board->blocks[k][l].color;
+    int b2_alive = board->blocks[k][l].alive;
+
+    board->blocks[i][j].color = b2_color;
+    board->blocks[i][j].alive = b2_alive;
+    board->blocks[k][l].color = b1_color;
+    board->blocks[k][l].alive = b1_alive;
+
+    blockSync(board, i,j);
+    blockSync(board, k,l);
 
     if (animate) {
-        blocks[i][j].start_col = blocks[k][l].dest_col;
-        blocks[i][j].start_row = blocks[k][l].dest_row;
-        blocks[i][j].x = blocks[k][l].dest_col*BLOCK_SIZE;
-        blocks[i][j].y = blocks[k][l].dest_row*BLOCK_SIZE;
-        blocks[i][j].sound_after_move = sound_after_move;
-        blocks[i][j].move_counter = blocks[i][j].move_counter_max = BLOCK_MOVE_FRAMES*(abs(i-k)+abs(j-l));
-        blocks[i][j].ease_func = ease_func;
-        blocks[k][l].start_col = blocks[i][j].dest_col;
-        blocks[k][l].start_row = blocks[i][j].dest_row;
-        blocks[k][l].x = blocks[i][j].dest_col*BLOCK_SIZE;
-        blocks[k][l].y = blocks[i][j].dest_row*BLOCK_SIZE;
-        blocks[k][l].sound_after_move = sound_after_move;;
-        blocks[k][l].ease_func = ease_func;
-        blocks[k][l].move_counter = blocks[k][l].move_counter_max = BLOCK_MOVE_FRAMES*(abs(i-k)+abs(j-l));
-    }
-}
-
-static bool blockCanMatch(int i, int j) {
-    return blocks[i][j].color != -1 && blocks[i][j].alive &&
-        blocks[i][j].clear_timer == 0 && blocks[i][j].frame <= 0;
-}
-
-bool blockCompare(int i, int j, int k, int l) {
-    if (!blockCanMatch(i, j) || !blockCanMatch(k, l)) return false;
-    if (blocks[i][j].color != blocks[k][l].color) return false;
-    if (blocks[i][j].alive != blocks[k][l].alive) return false;
+        board->block_anims[i][j].from_col = l-j;
+        board->block_anims[i][j].from_row = k-i;
+        board->block_anims[i][j].offset_x = (l-j)*BLOCK_SIZE;
+        board->block_anims[i][j].offset_y = (k-i)*BLOCK_SIZE;
+        board->block_anims[i][j].sound_after_move = sound_after_move;
+        board->block_anims[i][j].move_counter = board->block_anims[i][j].move_counter_max = board->block_move_frames*(abs(i-k)+abs(j-l));
+        board->block_anims[i][j].ease = ease;
+        board->block_anims[k][l].from_col = j-l;
+        board->block_anims[k][l].from_row = i-k;
+        board->block_anims[k][l].offset_x = (j-l)*BLOCK_SIZE;
+        board->block_anims[k][l].offset_y = (i-k)*BLOCK_SIZE;
+        board->block_anims[k][l].sound_after_move = sound_after_move;;
+        board->block_anims[k][l].ease = ease;
+        board->block_anims[k][l].move_counter = board->block_anims[k][l].move_counter_max = board->block_move_frames*(abs(i-k)+abs(j-l));
+        blockActivate(board, i,j);
+        blockActivate(board, k,l);
+    }
+}
+
+void blockSetReturn(Board *board, int i, int j, int k, int l) {
+    // switch (i,j) back with (k,l) once it stops moving, unless it matched
+    board->block_anims[i][j].returning = true;
+    board->block_anims[i][j].return_row = k-i;
+    board->block_anims[i][j].return_col = l-j;
+    indexSetAdd(&board->return_cells, blockPhysicalRow(board, i)*board->cols + j);
+}
+
+bool blockCompare(Board *board, int i, int j, int k, int l) {
+    if (!blockCanMatch(board, i, j) || !blockCanMatch(board, k, l)) return false;
+    if (board->blocks[i][j].color != board->blocks[k][l].color) return false;
+    if (board->blocks[i][j].alive != board->blocks[k][l].alive) return false;
     return true;
 }
 
-int blockMatchHorizontal(int i, int j) {
+int blockMatchVertical(Board *board, int i, int j) {
     int match_count = 0;
-    for(int k=j+1;k<COLS;k++) {
-        if (blockCompare(i,j,i,k))
+    for(int k=i+1;k<board->rows-board->disabled_rows;k++) {
+        if (blockCompare(board, i,j,k,j))
             match_count++;
         else
             break;
@@ -123,378 +300,860 @@ int blockMatchHorizontal(int i, int j) {
     return match_count;
 }
 
-int blockMatchVertical(int i, int j) {
-    int match_count = 0;
-    for(int k=i+1;k<ROWS-DISABLED_ROWS;k++) {
-        if (blockCompare(i,j,k,j))
-            match_count++;
-        else
-            break;
+int blockMatchAdjacent(Board *board, int i, int j) {
+    // Flood fill from (i,j) over matchable blocks of the same color, and
+    // return how many blocks were newly matched. Each block is marked when
+    // it's pushed, so the stack never holds more than rows*cols entries.
+    int last_row = board->rows - board->disabled_rows;
+    if (i >= last_row || !blockCanMatch(board, i, j) || board->blocks[i][j].matched) return 0;
+
+    int color = board->blocks[i][j].color;
+    int top = 0;
+    int count = 1;
+
+    blockBeginGroup(board, color, MATCH_REGION, 0);
+    blockMarkMatched(board, i, j);
+    board->flood_stack[top++] = i*board->cols + j;
+
+    while (top > 0) {
+        int cell = board->flood_stack[--top];
+        int k = cell / board->cols;
+        int l = cell % board->cols;
+        int next[4][2] = {{k-1, l}, {k+1, l}, {k, l-1}, {k, l+1}};
+
+        for (int n=0; n<4; n++) {
+            int a = next[n][0];
+            int b = next[n][1];
+            if (a < 0 || a >= last_row || b < 0 || b >= board->cols) continue;
+            if (!blockCanMatch(board, a, b)) continue;
+            if (board->blocks[a][b].color != color) continue;
+            // Already matched
+            if (board->blocks[a][b].matched) continue;
+
+            blockMarkMatched(board, a, b);
+            board->flood_stack[top++] = a*board->cols + b;
+            count++;
+        }
     }
-    return match_count;
-}
 
-static void blockMatchAdjacentImpl(int i, int j, int k, int l) {
-    if (k < 0 || k >= ROWS - DISABLED_ROWS || l < 0 || l >= COLS) return;
-    if (!blockCanMatch(k, l)) return;
-    if (blocks[i][j].color != blocks[k][l].color) return;
-    // Already matched
-    if (blocks[k][l].matched) return;
-    blocks[k][l].matched = true;
-    blockMatchAdjacentImpl(i, j, k - 1, l);
-    blockMatchAdjacentImpl(i, j, k + 1, l);
-    blockMatchAdjacentImpl(i, j, k, l - 1);
-    blockMatchAdjacentImpl(i, j, k, l + 1);
-}
-void blockMatchAdjacent(int i, int j) {
-    blockMatchAdjacentImpl(i, j, i, j);
+    board->match_groups[board->match_group_count].length = count;
+    blockEndGroup(board);
+    board->chain++;
+
+    return count;
 }
 
-int interpolateBlock(int start, int end, int counter, int counter_max, AHEasingFunction ease_func) {
-    float value = ease_func((float)(counter_max - counter + 1) / counter_max);
-    return (int)((start + ((end - start) * value))*BLOCK_SIZE);
+static int interpolateBlock(int home, int from, int counter, int counter_max, EaseType ease) {
+    // all in 16.16 fixed point; the position on the board is never negative,
+    // so the shift rounds down, and the result is the offset from home
+    int value = easeStep(ease, counter_max - counter + 1, counter_max);
+    int pos = ((home*BLOCK_SIZE << EASE_SHIFT) + from*BLOCK_SIZE*(EASE_ONE - value)) >> EASE_SHIFT;
+    return pos - home*BLOCK_SIZE;
 }
 
-bool blockAnimate() {
-    int i,j;
+bool blockAnimate(Board *board) {
     bool anim = false;
     bool drop_sound = false;
 
-    for (i=0;i<ROWS;i++) {
-        for (j=0;j<COLS;j++) {
-            bool was_moving = blocks[i][j].moving;
-            blocks[i][j].moving = false;
-
-            if (blocks[i][j].matched && blocks[i][j].frame < 8) {
-                if (blocks[i][j].clear_timer > 0) blocks[i][j].clear_timer--;
-                if (blocks[i][j].clear_timer == 0) {
-                    blocks[i][j].clear_timer = CLEAR_TIME;
-                    blocks[i][j].frame++;
-                }
-                anim = true;
+    // every other cell is at rest, so looking at it would change nothing
+    int kept = 0;
+    for (int n=0; n<board->active_cells.count; n++) {
+        int cell = board->active_cells.items[n];
+        int i = blockLogicalRow(board, cell / board->cols);
+        int j = cell % board->cols;
+
+        bool was_moving = board->block_anims[i][j].moving;
+        board->block_anims[i][j].moving = false;
+
+        if (board->blocks[i][j].matched && board->blocks[i][j].frame < 8) {
+            if (board->blocks[i][j].clear_timer > 0) board->blocks[i][j].clear_timer--;
+            if (board->blocks[i][j].clear_timer == 0) {
+                board->blocks[i][j].clear_timer = CLEAR_TIME;
+                board->blocks[i][j].frame++;
             }
+            blockSync(board, i,j);
+            anim = true;
+        }
 
-            // move blocks
-            if (blocks[i][j].move_counter > 0) {
-                blocks[i][j].x = interpolateBlock(blocks[i][j].start_col, blocks[i][j].dest_col, blocks[i][j].move_counter, blocks[i][j].move_counter_max, blocks[i][j].ease_func);
-                blocks[i][j].y = interpolateBlock(blocks[i][j].start_row, blocks[i][j].dest_row, blocks[i][j].move_counter, blocks[i][j].move_counter_max, blocks[i][j].ease_func);
-                blocks[i][j].move_counter--;
-                blocks[i][j].moving = true;
-                anim = true;
-            }
+        // move blocks
+        if (board->block_anims[i][j].move_counter > 0) {
+            board->block_anims[i][j].offset_x = interpolateBlock(j, board->block_anims[i][j].from_col, board->block_anims[i][j].move_counter, board->block_anims[i][j].move_counter_max, board->block_anims[i][j].ease);
+            board->block_anims[i][j].offset_y = interpolateBlock(i, board->block_anims[i][j].from_row, board->block_anims[i][j].move_counter, board->block_anims[i][j].move_counter_max, board->block_anims[i][j].ease);
+            board->block_anims[i][j].move_counter--;
+            board->block_anims[i][j].moving = true;
+            anim = true;
+        }
 
-            // play sound after block has finished moving
-            if (was_moving && !blocks[i][j].moving && blocks[i][j].alive && blocks[i][j].sound_after_move) {
-                drop_sound = true;
-                blocks[i][j].sound_after_move = false;
-            }
+        // play sound after block has finished moving
+        if (was_moving && !board->block_anims[i][j].moving && board->blocks[i][j].alive && board->block_anims[i][j].sound_after_move) {
+            drop_sound = true;
+            board->block_anims[i][j].sound_after_move = false;
         }
+
+        if (board->block_anims[i][j].moving || board->block_anims[i][j].move_counter > 0 || (board->blocks[i][j].matched && board->blocks[i][j].frame < 8))
+            board->active_cells.items[kept++] = cell;
+        else
+            board->active_cells.member[cell] = false;
     }
+    board->active_cells.count = kept;
 
-    if (drop_sound) Mix_PlayChannel(-1, sound_drop, 0);
+    if (drop_sound) coreEvent(board, CORE_EVENT_DROP);
 
     return anim;
 }
 
-void blockReturn() {
-    int i,j;
+void blockReturn(Board *board) {
+    // there are only ever a couple of these, so keep them in board order
+    for (int n=1; n<board->return_cells.count; n++) {
+        int cell = board->return_cells.items[n];
+        int k = n;
+        for (; k > 0 && blockLogicalCell(board, board->return_cells.items[k-1]) > blockLogicalCell(board, cell); k--)
+            board->return_cells.items[k] = board->return_cells.items[k-1];
+        board->return_cells.items[k] = cell;
+    }
 
-    for (i=0;i<ROWS;i++) {
-        for (j=0;j<COLS;j++) {
-            // If we attempted to switch this block but
-            // there is no match, move it back
-            if (blocks[i][j].move_counter == 0 && !blocks[i][j].matched && !blocks[i][j].moving && blocks[i][j].return_row != -1) {
-                blockSwitch(i, j, blocks[i][j].return_row, blocks[i][j].return_col, true, false, SineEaseInOut);
-                blocks[i][j].return_row = -1;
-                blocks[i][j].return_col = -1;
-            }
+    int kept = 0;
+    for (int n=0; n<board->return_cells.count; n++) {
+        int cell = board->return_cells.items[n];
+        int i = blockLogicalRow(board, cell / board->cols);
+        int j = cell % board->cols;
+
+        // If we attempted to switch this block but
+        // there is no match, move it back
+        if (board->block_anims[i][j].move_counter == 0 && !board->blocks[i][j].matched && !board->block_anims[i][j].moving && board->block_anims[i][j].returning) {
+            blockSwitch(board, i, j, i + board->block_anims[i][j].return_row, j + board->block_anims[i][j].return_col, true, false, EASE_SINE_IN_OUT);
+            board->block_anims[i][j].returning = false;
         }
+
+        if (board->block_anims[i][j].returning)
+            board->return_cells.items[kept++] = cell;
+        else
+            board->return_cells.member[cell] = false;
+    }
+    board->return_cells.count = kept;
+}
+
+static signed char* blockQueueRow(Board *board, int n) {
+    return &board->row_queue[((board->row_queue_head + n) % ROW_QUEUE_SIZE) * board->cols];
+}
+
+void blockQueueFill(Board *board) {
+    // Top the queue up once it's half empty. Each row is made the same way
+    // as blockAddLayerRandom() makes them, with the row before it in the
+    // queue (or the bottom row of the board) as the one above.
+    if (!board->row_queue || board->row_queue_count > ROW_QUEUE_SIZE/2) return;
+
+    while (board->row_queue_count < ROW_QUEUE_SIZE) {
+        signed char* row = blockQueueRow(board, board->row_queue_count);
+        signed char* above = board->row_queue_count > 0 ? blockQueueRow(board, board->row_queue_count-1) : NULL;
+        int last_color = -1;
+        for (int j=0; j<board->cols; j++) {
+            int up = above ? above[j] : board->blocks[board->rows-1][j].color;
+            row[j] = blockRandExcept(board, last_color, up);
+            last_color = row[j];
+        }
+        board->row_queue_count++;
+    }
+}
+
+int blockQueueCount(Board *board) {
+    return board->row_queue_count;
+}
+
+int blockQueuePeek(Board *board, int n, int j) {
+    // the color of column j in the n-th row to come, or -1 if it isn't known yet
+    if (n < 0 || n >= board->row_queue_count) return -1;
+    return blockQueueRow(board, n)[j];
+}
+
+void blockAddLayerQueued(Board *board, int i) {
+    if (board->row_queue_count == 0) {
+        blockAddLayerRandom(board, i);
+        return;
     }
+
+    signed char* row = blockQueueRow(board, 0);
+    for (int j=0; j<board->cols; j++) {
+        blockSet(board, i,j,true,row[j]);
+    }
+    board->row_queue_head = (board->row_queue_head + 1) % ROW_QUEUE_SIZE;
+    board->row_queue_count--;
 }
 
-void blockAddLayerRandom(int i) {
+void blockAddLayerRandom(Board *board, int i) {
     int j;
     int last_color = -1;
-    for(j=0;j<COLS;j++) {
-        int new_color = blockRand();
-        while (new_color == last_color || (i > 0 && new_color == blocks[i-1][j].color)) {
-            new_color = blockRand();
-        }
+    for(j=0;j<board->cols;j++) {
+        int new_color = blockRandExcept(board, last_color, i > 0 ? board->blocks[i-1][j].color : -1);
         last_color = new_color;
-        blockSet(i,j,true,new_color);
+        blockSet(board, i,j,true,new_color);
     }
 }
 
-bool blockHasMatches() {
-    // Check if there are any matches on the board
-    int i,j;
+static void blockScanRows(int first, int last, void* data) {
+    Board *board = data;
+    int last_row = board->rows-board->disabled_rows;
+    for (int n=first; n<last; n++)
+        board->scan_found[n] = planeMatchRow(&board->plane, board->scan_list[n], 0, last_row, board->scan_matches + n*BITBOARD_MAX_WORDS);
+}
 
-    for (i=0;i<ROWS;i++) {
-        for(j=0;j<COLS;j++) {
-            if (blocks[i][j].alive) {
-                // horizontal matches
-                if (blockMatchHorizontal(i,j) > 1) return true;
-                if (blockMatchVertical(i,j) > 1) return true;
-            }
-        }
-    }
-    return false;
+// A board row that fits in one BitWord, as the cells that can match and
+// the bits of their colors, so comparing two rows is a few word operations
+// however many colors there are
+typedef struct BlockRowBits{
+    BitWord matchable;
+    BitWord color_bit[3];
+}BlockRowBits;
+
+static BlockRowBits blockRowBits(Board *board, int physical_row) {
+    const Bitboard* bitboard = &board->bitboard;
+    int r = physical_row;
+    BitWord c3 = bitboard->color[3][r], c5 = bitboard->color[5][r];
+    BitWord c6 = bitboard->color[6][r], c7 = bitboard->color[7][r];
+    BlockRowBits bits = {bitboard->matchable[r], {
+        bitboard->color[1][r] | c3 | c5 | c7,
+        bitboard->color[2][r] | c3 | c6 | c7,
+        bitboard->color[4][r] | c5 | c6 | c7}};
+    return bits;
+}
+
+static BitWord blockRowBitsEqual(BlockRowBits a, BlockRowBits b) {
+    // cells that can match in both rows and have the same color in each
+    BitWord differ = (a.color_bit[0] ^ b.color_bit[0]) | (a.color_bit[1] ^ b.color_bit[1]) | (a.color_bit[2] ^ b.color_bit[2]);
+    return a.matchable & b.matchable & ~differ;
 }
 
-void blockSetDefaults() {
-    blockCleanup();
+static BitWord blockRowBitsRuns(BlockRowBits a) {
+    // cells in a horizontal run of 3 or more
+    BlockRowBits next = {a.matchable >> 1, {a.color_bit[0] >> 1, a.color_bit[1] >> 1, a.color_bit[2] >> 1}};
+    BitWord eq = blockRowBitsEqual(a, next);
+    BitWord starts = eq & eq >> 1;
+    return starts | starts << 1 | starts << 2;
+}
+
+// One set of kernels per board size the game modes use, named by width x height.
+// A row of each of these fits in one BitWord.
+#define KERNEL_SUFFIX 13x10
+#define KERNEL_ONE_WORD
+#define KERNEL_SIZE 10, 13, 1
+#define KERNEL_ROWS 10
+#define KERNEL_COLS 13
+#define KERNEL_DISABLED_ROWS 1
+#include "block_kernels.h"
+
+#define KERNEL_SUFFIX 8x8
+#define KERNEL_ONE_WORD
+#define KERNEL_SIZE 8, 8, 0
+#define KERNEL_ROWS 8
+#define KERNEL_COLS 8
+#define KERNEL_DISABLED_ROWS 0
+#include "block_kernels.h"
+
+#define KERNEL_SUFFIX 8x9
+#define KERNEL_ONE_WORD
+#define KERNEL_SIZE 9, 8, 1
+#define KERNEL_ROWS 9
+#define KERNEL_COLS 8
+#define KERNEL_DISABLED_ROWS 1
+#include "block_kernels.h"
+
+// and one for any other size
+#define KERNEL_SUFFIX generic
+#define KERNEL_SIZE 0, 0, 0
+#define KERNEL_ROWS board->rows
+#define KERNEL_COLS board->cols
+#define KERNEL_DISABLED_ROWS board->disabled_rows
+#include "block_kernels.h"
+
+bool blockHasMatches(Board *board) {
+    return board->kernels->hasMatches(board);
+}
 
-    game_mode->setDefaults();
+void blockSetDefaults(Board *board) {
+    blockCleanup(board);
 
-    DRAW_OFFSET_X = (SCREEN_WIDTH - COLS * BLOCK_SIZE) / 2;
-    DRAW_OFFSET_Y = (SCREEN_HEIGHT - ROWS * BLOCK_SIZE) / 2;
-    CURSOR_MAX_Y = ROWS-1-DISABLED_ROWS;
+    board->mode->setDefaults(board);
 
-    // We need to change our vertical offset if the block size != status bar size
-    DRAW_OFFSET_Y += game_mode->drawOffsetExtraY;
+    board->cursor_max_y = board->rows-1-board->disabled_rows;
 
-    blocks = malloc(sizeof(Block*)*ROWS);
-    for (int i=0; i<ROWS; i++) {
-        blocks[i] = malloc(sizeof(Block)*COLS);
+    // row pointers first, then the animation cells, then the logic cells,
+    // so that every part stays aligned for its type
+    size_t row_size = (sizeof(Block*) + sizeof(BlockAnim*))*2*board->rows;
+    char* mem = calloc(1, row_size + (sizeof(BlockAnim) + sizeof(Block))*board->rows*board->cols);
+
+    board->block_rows = (Block**)mem;
+    board->anim_rows = (BlockAnim**)(mem + sizeof(Block*)*2*board->rows);
+    BlockAnim* anim_cells = (BlockAnim*)(mem + row_size);
+    Block* cells = (Block*)(anim_cells + board->rows*board->cols);
+    for (int i=0; i<2*board->rows; i++) {
+        board->block_rows[i] = cells + (i%board->rows)*board->cols;
+        board->anim_rows[i] = anim_cells + (i%board->rows)*board->cols;
+    }
+
+    board->row_base = 0;
+    board->blocks = board->block_rows;
+    board->block_anims = board->anim_rows;
+
+    // use the mode's specialized kernels if the board is the size they were
+    // built for, since a mode's size can be changed
+    board->kernels = &block_kernels_generic;
+    if (board->mode->kernels &&
+        board->mode->kernels->rows == board->rows &&
+        board->mode->kernels->cols == board->cols &&
+        board->mode->kernels->disabled_rows == board->disabled_rows)
+        board->kernels = board->mode->kernels;
+
+    bitboardInit(&board->bitboard, board->rows, board->cols);
+    planeInit(&board->plane, &board->bitboard, board->rows, board->cols);
+    if (board->mode->moves)
+        movesInit(board);
+
+    indexSetInit(&board->dirty_rows, board->rows);
+    board->scan_row = calloc(board->rows, sizeof(bool));
+    board->scan_list = malloc(sizeof(int)*board->rows);
+    board->scan_matches = malloc(sizeof(BitWord)*board->rows*BITBOARD_MAX_WORDS);
+    board->scan_found = malloc(sizeof(bool)*board->rows);
+    indexSetInit(&board->active_cells, board->rows*board->cols);
+    indexSetInit(&board->return_cells, board->rows*board->cols);
+    board->match_groups = malloc(sizeof(MatchGroup)*(board->rows*board->cols+1));
+    board->match_cells = malloc(sizeof(int)*board->rows*board->cols);
+    board->match_group_count = 0;
+    board->match_cell_count = 0;
+    board->match_overflow = false;
+    board->flood_stack = malloc(sizeof(int)*board->rows*board->cols);
+
+    if (board->rows*board->cols >= PARALLEL_CELLS) {
+        board->fall_from = malloc(sizeof(int)*board->rows*board->cols);
+        board->fall_to = malloc(sizeof(int)*board->rows*board->cols);
+        board->fall_count = malloc(sizeof(int)*board->cols);
     }
+
+    // only the modes with a speed setting rise, and so need new rows
+    if (board->mode->speed)
+        board->row_queue = malloc(sizeof(signed char)*ROW_QUEUE_SIZE*board->cols);
+    board->row_queue_head = 0;
+    board->row_queue_count = 0;
+
+    board->hash_content = malloc(sizeof(signed char)*board->rows*board->cols);
+    memset(board->hash_content, -1, sizeof(signed char)*board->rows*board->cols);
+    board->row_hash = calloc(board->rows, sizeof(uint64_t));
+    board->hash = 0;
+    board->column_height = calloc(board->cols, sizeof(int));
+}
+
+void blockCleanup(Board *board) {
+    // all the rows live in the same allocation
+    free(board->block_rows);
+    board->block_rows = NULL;
+    board->anim_rows = NULL;
+    board->blocks = NULL;
+    board->block_anims = NULL;
+    bitboardCleanup(&board->bitboard);
+    planeCleanup(&board->plane);
+    movesCleanup(board);
+
+    indexSetFree(&board->dirty_rows);
+    free(board->scan_row);
+    board->scan_row = NULL;
+    free(board->scan_list);
+    board->scan_list = NULL;
+    free(board->scan_matches);
+    board->scan_matches = NULL;
+    free(board->scan_found);
+    board->scan_found = NULL;
+    free(board->fall_from);
+    board->fall_from = NULL;
+    free(board->fall_to);
+    board->fall_to = NULL;
+    free(board->fall_count);
+    board->fall_count = NULL;
+    indexSetFree(&board->active_cells);
+    indexSetFree(&board->return_cells);
+    free(board->match_groups);
+    board->match_groups = NULL;
+    free(board->match_cells);
+    board->match_cells = NULL;
+    board->match_group_count = 0;
+    board->match_cell_count = 0;
+    free(board->flood_stack);
+    board->flood_stack = NULL;
+    free(board->row_queue);
+    board->row_queue = NULL;
+    board->row_queue_head = 0;
+    board->row_queue_count = 0;
+    free(board->hash_content);
+    board->hash_content = NULL;
+    free(board->row_hash);
+    board->row_hash = NULL;
+    board->hash = 0;
+    free(board->column_height);
+    board->column_height = NULL;
 }
 
-void blockCleanup() {
-    if (blocks != NULL) {
-        for (int i=0; i<ROWS; i++) {
-            free(blocks[i]);
+void blockInitAll(Board *board) {
+    int i,j;
+
+    rngSeed(&board->rng, board->seed);
+    blockSetDefaults(board);
+
+    board->animating = false;
+    board->chain = 0;
+    board->chain_count = 0;
+    board->idle_pass = false;
+    board->bump_timer = 0;
+    board->bump_pixels = 0;
+    board->speed = board->speed_init;
+    board->speed_timer = SPEED_TIME;
+    board->game_over_timer = 0;
+    board->score = 0;
+    board->jewels_cursor_select = false;
+
+    for(i=0;i<board->rows;i++) {
+        for(j=0;j<board->cols;j++) {
+            blockSet(board, i,j,false,-1);
         }
-        free(blocks);
-        blocks = NULL;
     }
+
+    board->mode->initAll(board);
+
+    // the first rows to come up follow on from the bottom row
+    blockQueueFill(board);
 }
 
-void blockInitAll() {
-    int i,j;
+static bool blockIsStable(Board *board) {
+    // The last logic pass changed nothing and nothing has changed since, so
+    // another pass would only count the rise timers down. A player's move
+    // or a new layer clears this by changing the board.
+    return board->idle_pass && board->version == board->idle_version &&
+        blockIsSettled(board) && board->return_cells.count == 0;
+}
 
-    blockSetDefaults();
+static int blockAnimIdleFrames(Board *board) {
+    // How many animation frames go by before a block changes its clear frame
+    // or finishes moving. Those frames only count down.
+    if (board->active_cells.count == 0) return 0;
+
+    int idle = INT_MAX;
+    for (int n=0; n<board->active_cells.count; n++) {
+        int cell = board->active_cells.items[n];
+        int i = blockLogicalRow(board, cell / board->cols);
+        int j = cell % board->cols;
+        bool clearing = board->blocks[i][j].matched && board->blocks[i][j].frame < 8;
+
+        if (clearing)
+            idle = min(idle, max(board->blocks[i][j].clear_timer, 1) - 1);
+        if (board->block_anims[i][j].move_counter > 0)
+            idle = min(idle, board->block_anims[i][j].move_counter - 1);
+        else if (!clearing)
+            return 0;
+    }
+    return idle;
+}
 
-    animating = false;
-    bump_timer = 0;
-    bump_pixels = 0;
-    speed = speed_init;
-    speed_timer = SPEED_TIME;
-    game_over_timer = 0;
-    jewels_cursor_select = false;
+int blockIdleFrames(Board *board) {
+    // How many of the next blockLogic() calls would do nothing but count
+    // timers down, if there's no input. blockSkipFrames() can do that many
+    // at once. INT_MAX means nothing will ever happen by itself.
+    if (board->game_over_timer > 0) return 0;
+
+    // with instant_resolve, the next call plays the animations out itself
+    if (board->active_cells.count > 0)
+        return board->instant_resolve ? 0 : blockAnimIdleFrames(board);
+
+    // otherwise these are logic passes, which repeat the last one
+    if (!blockIsStable(board)) return 0;
+    if (board->row_queue && board->row_queue_count <= ROW_QUEUE_SIZE/2) return 0;
+    if (!board->mode->speed) return INT_MAX;
+
+    // same countdowns as blockRise()
+    int idle = max(board->bump_timer, 1) - 1;
+    if (board->speed < MAX_SPEED)
+        idle = min(idle, max(board->speed_timer, 1) - 1);
+    return idle;
+}
 
-    for(i=0;i<ROWS;i++) {
-        for(j=0;j<COLS;j++) {
-            blockSet(i,j,false,-1);
+void blockSkipFrames(Board *board, int frames) {
+    // Do the next frames calls to blockLogic() in one go. frames must be no
+    // more than blockIdleFrames().
+    if (frames <= 0) return;
+
+    if (board->active_cells.count > 0) {
+        for (int n=0; n<board->active_cells.count; n++) {
+            int cell = board->active_cells.items[n];
+            int i = blockLogicalRow(board, cell / board->cols);
+            int j = cell % board->cols;
+
+            if (board->blocks[i][j].matched && board->blocks[i][j].frame < 8)
+                board->blocks[i][j].clear_timer -= frames;
+
+            BlockAnim* anim = &board->block_anims[i][j];
+            if (anim->move_counter > 0) {
+                // the offsets only depend on the counter, so jump to where
+                // the last of the skipped frames would have left them
+                int counter = anim->move_counter - frames + 1;
+                anim->offset_x = interpolateBlock(j, anim->from_col, counter, anim->move_counter_max, anim->ease);
+                anim->offset_y = interpolateBlock(i, anim->from_row, counter, anim->move_counter_max, anim->ease);
+                anim->move_counter -= frames;
+                anim->moving = true;
+            }
         }
+        board->animating = true;
+        return;
     }
 
-    game_mode->initAll();
+    if (board->mode->speed) {
+        board->bump_timer -= frames;
+        board->speed_timer = max(board->speed_timer - frames, 0);
+    }
+    board->animating = false;
 }
 
-void blockLogic() {
-    animating = blockAnimate();
-
-    if (animating)
-        return;
+int blockColumnTop(Board *board, int j) {
+    // the row of the top block in the stack at the bottom of column j, or
+    // rows if the column is empty
+    return board->rows - board->column_height[j];
+}
 
-    game_mode->blockLogic();
+bool blockIsSettled(Board *board) {
+    // nothing is moving or clearing, so the board won't change by itself
+    return board->active_cells.count == 0 && board->match_group_count == 0;
 }
 
-void blockRise() {
-    if (bump_timer > 0) bump_timer--;
-    if (bump_timer == 0) {
-        bump_pixels++;
-        bump_timer = BUMP_TIME - (speed*SPEED_FACTOR);
-        if (bump_timer < 0) bump_timer = 0;
+static void blockLogicPass(Board *board) {
+    unsigned before = board->version;
+    if (!blockIsStable(board)) {
+        board->mode->blockLogic(board);
     }
-    if (bump_pixels > 0 && bump_pixels % BLOCK_SIZE == 0) {
-        blockAddLayer();
-        bump_pixels -= BLOCK_SIZE;
+    else if (board->mode->speed) {
+        // Clearing, matching and gravity would find nothing to do, and
+        // neither would the gravity after a new layer, which only moves
+        // every stack up a row
+        blockRise(board);
     }
-    if (speed_timer > 0) speed_timer--;
-    if (speed < MAX_SPEED && speed_timer == 0) {
-        speed++;
-        speed_timer = SPEED_TIME;
+    board->idle_pass = board->version == before;
+    board->idle_version = board->version;
+
+    if (blockIsSettled(board) && board->chain > 0) {
+        board->chain_count = board->chain;
+        board->chain = 0;
     }
 }
 
-void blockAddFromTop() {
-    for(int j=0;j<COLS;j++)
-        if (!blocks[0][j].alive)
-            blockSet(0,j,true,blockRand());
+void blockLogic(Board *board) {
+    blockQueueFill(board);
+
+    if (board->instant_resolve) {
+        // Run the animations to the end and the game logic after them, the
+        // same steps in the same order as animated play would over the next
+        // frames, until the board is settled
+        while (board->game_over_timer == 0) {
+            blockSkipFrames(board, blockAnimIdleFrames(board));
+            board->animating = blockAnimate(board);
+            if (board->animating)
+                continue;
+
+            blockLogicPass(board);
+            if (blockIsSettled(board))
+                break;
+        }
+        board->animating = false;
+        return;
+    }
+
+    board->animating = blockAnimate(board);
+
+    if (board->animating)
+        return;
+
+    blockLogicPass(board);
 }
 
-void blockGravity() {
-    int i,j,k;
+void blockRise(Board *board) {
+    if (board->bump_timer > 0) board->bump_timer--;
+    if (board->bump_timer == 0) {
+        board->bump_pixels++;
+        board->bump_timer = BUMP_TIME - (board->speed*SPEED_FACTOR);
+        if (board->bump_timer < 0) board->bump_timer = 0;
+    }
+    if (board->bump_pixels > 0 && board->bump_pixels % BLOCK_SIZE == 0) {
+        blockAddLayer(board);
+        board->bump_pixels -= BLOCK_SIZE;
+    }
+    if (board->speed_timer > 0) board->speed_timer--;
+    if (board->speed < MAX_SPEED && board->speed_timer == 0) {
+        board->speed++;
+        board->speed_timer = SPEED_TIME;
+    }
+}
 
-    for (j=0;j<COLS;j++) {
-        int gap_size = 0;
-        int first_empty = -1;
-        for (k=ROWS-1; k>0; k--) {
-            if (first_empty == -1 && !blocks[k][j].alive)
-                first_empty = k;
+void blockAddFromTop(Board *board) {
+    for(int j=0;j<board->cols;j++)
+        if (!board->blocks[0][j].alive)
+            blockSet(board, 0,j,true,blockRand(board));
+}
 
-            if (first_empty != -1) {
-                if (!blocks[k][j].alive)
-                    gap_size++;
-                else
-                    break;
+static void blockGravityScan(int first, int last, void* data) {
+    // the same decisions as the gravity kernel makes, for columns
+    // [first, last), without moving anything yet
+    Board *board = data;
+    for (int j=first; j<last; j++) {
+        int* from = board->fall_from + j*board->rows;
+        int* to = board->fall_to + j*board->rows;
+        int count = 0;
+        int dest = board->rows-1;
+
+        for (int i=board->rows-1; i>=0; i--) {
+            if (!board->blocks[i][j].alive)
+                continue;
+
+            if (board->blocks[i][j].matched) {
+                dest = i-1;
             }
-        }
-
-        if (gap_size > 0) {
-            for (i=first_empty-gap_size;i>=0;i--) {
-                if (blocks[i][j].alive) {
-                    blockSwitch(i,j,i+gap_size,j, true, true, SineEaseIn);
+            else {
+                if (dest != i) {
+                    from[count] = i;
+                    to[count] = dest;
+                    count++;
                 }
+                dest--;
             }
         }
+        board->fall_count[j] = count;
     }
 }
 
-void blockClearMatches() {
-    if (animating) return;
+void blockGravity(Board *board) {
+    if (!board->fall_from || workersCount() == 1) {
+        board->kernels->gravity(board);
+        return;
+    }
+
+    // Each column only depends on itself, so the scan can be split up. The
+    // moves are made afterwards in the same order as the kernel makes them.
+    workersRun(board->cols, PARALLEL_BAND, blockGravityScan, board);
+    for (int j=0; j<board->cols; j++) {
+        for (int n=0; n<board->fall_count[j]; n++)
+            blockSwitch(board, board->fall_from[j*board->rows + n], j, board->fall_to[j*board->rows + n], j, true, true, EASE_SINE_IN);
+    }
+}
+
+void blockClearMatches(Board *board) {
+    if (board->animating || (board->match_group_count == 0 && !board->match_overflow)) return;
 
     // now, clear all the matches
+    // every matched block is in exactly one group, unless it was reset since
     int blocks_cleared = 0;
-    for (int i=0;i<ROWS-DISABLED_ROWS;i++) {
-        for(int j=0;j<COLS;j++) {
-            if (blocks[i][j].matched) {
-                blockClear(i,j);
+    for (int g=0; g<board->match_group_count; g++) {
+        for (int k=0; k<board->match_groups[g].cell_count; k++) {
+            int i, j;
+            blockGetMatchCell(board, &board->match_groups[g], k, &i, &j);
+            if (board->blocks[i][j].matched) {
+                blockClear(board, i,j);
                 blocks_cleared++;
             }
         }
     }
+    if (board->match_overflow) {
+        for (int i=0;i<board->rows;i++) {
+            for(int j=0;j<board->cols;j++) {
+                if (board->blocks[i][j].matched) {
+                    blockClear(board, i,j);
+                    blocks_cleared++;
+                }
+            }
+        }
+    }
+    board->match_group_count = 0;
+    board->match_cell_count = 0;
+    board->match_overflow = false;
+
     if (blocks_cleared > 2) {
-        score += blocks_cleared * POINTS_PER_BLOCK;
-        if (blocks_cleared-3 > 0) score += (blocks_cleared-3) * POINTS_PER_COMBO_BLOCK;
+        board->score += blocks_cleared * POINTS_PER_BLOCK;
+        if (blocks_cleared-3 > 0) board->score += (blocks_cleared-3) * POINTS_PER_COMBO_BLOCK;
     }
 }
 
-void blockFindMatch3() {
-    bool new_match = false;
-    // next, mark all the blocks that will be cleared
-    // skip the bottom rows because blocks there aren't fully "in" the block field
-    for (int i=0;i<ROWS-DISABLED_ROWS;i++) {
-        for(int j=0;j<COLS;j++) {
-            if (blocks[i][j].alive) {
-                // horizontal matches
-                int match_count = blockMatchHorizontal(i,j);
-                if (match_count > 1) {
-                    for(int k=j;k<j+match_count+1;k++) {
-                        blocks[i][k].matched = true;
-                        new_match = true;
-                    }
-                }
-                // vertical matches
-                match_count = blockMatchVertical(i,j);
-                if (match_count > 1) {
-                    for(int k=i;k<i+match_count+1;k++) {
-                        blocks[k][j].matched = true;
-                        new_match = true;
-                    }
-                }
+uint64_t blockHash(Board *board) {
+    // The board's hash, plus the cursor and whatever the player is holding
+    int held_color = -1;
+    int held_amount = 0;
+    board->mode->getHeld(board, &held_color, &held_amount);
+
+    return board->hash ^
+        zobristField(ZOBRIST_CURSOR_X1, board->cursor.x1) ^
+        zobristField(ZOBRIST_CURSOR_Y1, board->cursor.y1) ^
+        zobristField(ZOBRIST_CURSOR_X2, board->cursor.x2) ^
+        zobristField(ZOBRIST_CURSOR_Y2, board->cursor.y2) ^
+        zobristField(ZOBRIST_HELD_COLOR, held_color) ^
+        zobristField(ZOBRIST_HELD_AMOUNT, held_amount);
+}
+
+int blockMatchGroupCount(Board *board) {
+    return board->match_group_count;
+}
+
+const MatchGroup* blockGetMatchGroup(Board *board, int n) {
+    return &board->match_groups[n];
+}
+
+void blockGetMatchCell(Board *board, const MatchGroup* group, int k, int* i, int* j) {
+    int cell = blockLogicalCell(board, board->match_cells[group->first_cell + k]);
+    *i = cell / board->cols;
+    *j = cell % board->cols;
+}
+
+static bool blockMatchesColor(Board *board, int i, int j, int color) {
+    return blockCanMatch(board, i, j) && board->blocks[i][j].color == color;
+}
+
+static void blockMatchLine(Board *board, int i, int j, bool vertical, int last_row) {
+    // Walk the whole run of same colored blocks through (i,j) and, if it's
+    // long enough, put the blocks in it that aren't matched yet in a group
+    int color = board->blocks[i][j].color;
+    int di = vertical ? 1 : 0;
+    int dj = vertical ? 0 : 1;
+    int rows = vertical ? last_row : board->rows;
+
+    int first = 0;
+    while (i-(first+1)*di >= 0 && j-(first+1)*dj >= 0 && blockMatchesColor(board, i-(first+1)*di, j-(first+1)*dj, color))
+        first++;
+    int last = 0;
+    while (i+(last+1)*di < rows && j+(last+1)*dj < board->cols && blockMatchesColor(board, i+(last+1)*di, j+(last+1)*dj, color))
+        last++;
+
+    int length = first + last + 1;
+    if (length < 3) return;
+
+    blockBeginGroup(board, color, vertical ? MATCH_COLUMN : MATCH_ROW, length);
+    for (int n=-first; n<=last; n++) {
+        if (!board->blocks[i+n*di][j+n*dj].matched)
+            blockMarkMatched(board, i+n*di, j+n*dj);
+    }
+    blockEndGroup(board);
+}
+
+void blockFindMatch3(Board *board) {
+    int groups_before = board->match_group_count;
+    int last_row = board->rows-board->disabled_rows;
+
+    // only rows near a change can have a new match, since a vertical run
+    // can reach 2 rows away from the cell that completed it
+    int scan_count = 0;
+    for (int d=0; d<board->dirty_rows.count; d++) {
+        int i = blockLogicalRow(board, board->dirty_rows.items[d]);
+        board->dirty_rows.member[board->dirty_rows.items[d]] = false;
+        for (int k=max(i-2, 0); k<=min(i+2, last_row-1); k++) {
+            if (!board->scan_row[k]) {
+                board->scan_row[k] = true;
+                scan_count++;
             }
         }
     }
+    board->dirty_rows.count = 0;
 
-    if (new_match) Mix_PlayChannel(-1,sound_match,0);
+    // skip the bottom rows because blocks there aren't fully "in" the block field
+    int listed = 0;
+    for (int i=0; i<last_row && listed < scan_count; i++) {
+        if (board->scan_row[i]) {
+            board->scan_row[i] = false;
+            board->scan_list[listed++] = i;
+        }
+    }
+
+    // Marking blocks as matched doesn't change what can match, so every row
+    // can be checked before any groups are made. Each row's cells are
+    // written to its own slot, so bands of rows can be checked at once.
+    if (scan_count > 0)
+        board->kernels->matchRows(board, scan_count);
+
+    // next, mark all the blocks that will be cleared, a row at a time in
+    // order, turning the marked cells into groups, one per run
+    for (int n=0; n<scan_count; n++) {
+        if (!board->scan_found[n])
+            continue;
+
+        int i = board->scan_list[n];
+        BitWord* matches = board->scan_matches + n*BITBOARD_MAX_WORDS;
+        for (int j=bitboardNextBit(&board->bitboard, matches, 0); j != -1; j=bitboardNextBit(&board->bitboard, matches, j+1)) {
+            blockMatchLine(board, i, j, false, last_row);
+            blockMatchLine(board, i, j, true, last_row);
+        }
+    }
+
+    if (board->match_group_count > groups_before) {
+        board->chain++;
+        coreEvent(board, CORE_EVENT_MATCH);
+    }
 }
 
-bool blockAddLayer() {
-    if (animating) return false;
+bool blockAddLayer(Board *board) {
+    if (board->animating) return false;
 
     int i,j;
 
     // check if one of the columns is full
     // if so, set game over state
     // display the "try again" menu after 2 seconds
-    for (j=0;j<COLS;j++) {
-        if (blocks[1][j].alive) {
-            game_over_timer = FPS*2;
+    for (j=0; j<board->cols; j++) {
+        if (board->column_height[j] >= board->rows-1) {
+            board->game_over_timer = FPS*2;
+            break;
         }
     }
 
-    if (cursor.y1 > CURSOR_MIN_Y) cursor.y1--;
-    cursor.y2 = cursor.y1;
+    if (board->cursor.y1 > board->cursor_min_y) board->cursor.y1--;
+    board->cursor.y2 = board->cursor.y1;
 
-    for (j=0;j<COLS;j++) {
-        for (i=1;i<ROWS;i++) {
-            blockSwitch(i,j,i-1,j, false, false, LinearInterpolation);
-        }
-    }
+    // move every row up by one; the old top row wraps around to the bottom,
+    // where it's replaced by the new layer
+    board->row_base = (board->row_base + 1) % board->rows;
+    board->blocks = board->block_rows + board->row_base;
+    board->block_anims = board->anim_rows + board->row_base;
+    bitboardRotate(&board->bitboard);
+    planeRotate(&board->plane);
+    movesRotate(board);
+    board->version++;
+
+    // every row has a new number, so its key changes
+    board->hash = 0;
+    for (i=0; i<board->rows; i++)
+        board->hash ^= zobristRow(i, board->row_hash[blockPhysicalRow(board, i)]);
 
-    blockAddLayerRandom(ROWS-1);
+    // every stack moves up a row, and the new layer below is always full
+    for (j=0; j<board->cols; j++)
+        board->column_height[j] = min(board->column_height[j] + 1, board->rows);
+
+    // the rows that just left the disabled area haven't been checked for matches
+    for (i=board->rows-1-board->disabled_rows; i<board->rows-1; i++)
+        indexSetAdd(&board->dirty_rows, blockPhysicalRow(board, i));
+
+    blockAddLayerQueued(board, board->rows-1);
 
     // reset bump pixels to the previous block level
-    bump_pixels -= bump_pixels % BLOCK_SIZE;
+    board->bump_pixels -= board->bump_pixels % BLOCK_SIZE;
 
     return true;
 }
 
-bool blockHasSwitchMatch() {
+bool blockHasSwitchMatch(Board *board) {
     // check if no moves will result in any matches
-    // do this by performing every possible switch and checking for matches
-    int i,j;
-    bool has_switch_match = false;
-
-    for (j=0;j<COLS;j++) {
-        for (i=0;i<ROWS;i++) {
-            blockSwitch(i,j,i+1,j,false,false,LinearInterpolation);
-            has_switch_match = has_switch_match || blockHasMatches();
-            blockSwitch(i,j,i+1,j,false,false,LinearInterpolation);
-            blockSwitch(i,j,i,j+1,false,false,LinearInterpolation);
-            has_switch_match = has_switch_match || blockHasMatches();
-            blockSwitch(i,j,i,j+1,false,false,LinearInterpolation);
-            if (has_switch_match) return true;
-        }
-        if (has_switch_match) return true;
-    }
-    return false;
-}
+    // any match already on the board counts too, like a switch that does nothing
+    if (movesEnabled(board))
+        return movesCount(board) > 0 || movesRunCount(board) > 0;
 
-bool blockHasGaps() {
-    int i,j;
+    // without the index, perform every possible switch and check for matches
+    return board->kernels->hasSwitchMatch(board);
+}
 
-    for (j=0;j<COLS;j++)
-        for (i=0;i<ROWS;i++)
-            if (!blocks[i][j].alive) return true;
-    return false;
+bool blockHasGaps(Board *board) {
+    return board->kernels->hasGaps(board);
 }
 
-bool blockSwitchCursor() {
+bool blockSwitchCursor(Board *board) {
     // don't allow switching blocks that are already moving
-    if (blocks[cursor.y1][cursor.x1].moving == false && blocks[cursor.y2][cursor.x2].moving == false) {
-        blockSwitch(cursor.y1, cursor.x1, cursor.y2, cursor.x2, true, false, SineEaseOut);
+    if (board->block_anims[board->cursor.y1][board->cursor.x1].moving == false && board->block_anims[board->cursor.y2][board->cursor.x2].moving == false) {
+        blockSwitch(board, board->cursor.y1, board->cursor.x1, board->cursor.y2, board->cursor.x2, true, false, EASE_SINE_OUT);
         return true;
     }
     return false;
 }
-
-void blockGetAtMouse(int* block_x, int* block_y) {
-    if (!block_x || !block_y) return;
-
-    *block_x = -1;
-    *block_y = -1;
-
-    int mx = mouse_x;
-    int my = mouse_y;
-
-    if (game_mode == &game_mode_default)
-        mx -= (BLOCK_SIZE/2);
-
-    if (mx < DRAW_OFFSET_X)
-        return;
-
-    if (my < DRAW_OFFSET_Y)
-        return;
-
-    int x = (mx - DRAW_OFFSET_X) / BLOCK_SIZE;
-    int y = (my - DRAW_OFFSET_Y + bump_pixels) / BLOCK_SIZE;
-
-    if (x >= 0 && x <= CURSOR_MAX_X)
-        *block_x = x;
-
-    if (y >= CURSOR_MIN_Y && y <= CURSOR_MAX_Y)
-        *block_y = y;
-}
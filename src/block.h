@@ -19,8 +19,14 @@
 #ifndef BLOCK_H
 #define BLOCK_H
 
-#include "easing.h"
-#include "sys.h"
+#include <stdint.h>
+
+#include "bitboard.h"
+#include "core.h"
+#include "ease.h"
+#include "moves.h"
+#include "plane.h"
+#include "rng.h"
 
 #ifdef HALF_GFX
 #define BLOCK_SIZE 24
@@ -34,73 +40,246 @@
 #define SPEED_TIME 1800 / (60/FPS)
 #define MAX_SPEED 25
 
-const int POINTS_PER_BLOCK;
-const int POINTS_PER_BUMP;
-const int POINTS_PER_COMBO_BLOCK;
-
-int ROWS;
-int COLS;
-int NUM_BLOCKS;
-int START_ROWS;
-int DISABLED_ROWS;
-int CURSOR_MAX_X;
-int CURSOR_MIN_Y;
-int CURSOR_MAX_Y;
-int BLOCK_MOVE_FRAMES;
-int DRAW_OFFSET_X;
-int DRAW_OFFSET_Y;
+extern const int POINTS_PER_BLOCK;
+extern const int POINTS_PER_BUMP;
+extern const int POINTS_PER_COMBO_BLOCK;
+
+struct Board;
+struct GameMode;
 
+struct Cursor {
+    int x1;
+    int y1;
+    int x2;
+    int y2;
+};
+
+// Logic state, read by the matching code for every cell
 typedef struct Block{
-    int x,y;
-    int start_col, start_row;
-    int dest_col, dest_row;
+    signed char color;
     bool alive;
-    int color;
     bool matched;
-    int clear_timer;
-    int frame;
+    signed char frame;
+    unsigned char clear_timer;
+}Block;
+
+// Animation state, only touched while a block is moving. Everything is
+// relative to the block's own cell, so it stays valid when rows are rotated.
+typedef struct BlockAnim{
+    int offset_x, offset_y;
+    int from_col, from_row;
     bool moving;
     int move_counter;
     int move_counter_max;
-    AHEasingFunction ease_func;
+    EaseType ease;
+    bool returning;
     int return_row, return_col;
     bool sound_after_move;
-}Block;
+}BlockAnim;
+
+// A run of matching blocks, found by blockFindMatch3() or blockMatchAdjacent().
+// length covers the whole run, but cells only lists the blocks this group
+// matched itself, so every matched block is in exactly one group.
+typedef enum {
+    MATCH_ROW, MATCH_COLUMN, MATCH_REGION
+}MatchShape;
+
+typedef struct MatchGroup{
+    signed char color;
+    MatchShape shape;
+    int length;
+    int first_cell;
+    int cell_count;
+}MatchGroup;
+
+// The loops over the whole board, built once for each board size the game
+// modes use (see block_kernels.h) and once for any size. rows, cols and
+// disabled_rows are the size a set was built for, or 0 for the generic set.
+// matchRows checks the first count rows of scan_list for blockFindMatch3().
+typedef struct BlockKernels{
+    int rows, cols, disabled_rows;
+    void (*gravity)(struct Board *board);
+    void (*matchRows)(struct Board *board, int count);
+    bool (*hasMatches)(struct Board *board);
+    bool (*hasSwitchMatch)(struct Board *board);
+    bool (*hasGaps)(struct Board *board);
+}BlockKernels;
+
+extern const BlockKernels block_kernels_13x10;
+extern const BlockKernels block_kernels_8x8;
+extern const BlockKernels block_kernels_8x9;
+extern const BlockKernels block_kernels_generic;
+
+// A set of row or cell indices, kept in the order they were added
+typedef struct IndexSet{
+    int *items;
+    bool *member;
+    int count;
+}IndexSet;
+
+// One game in progress, with everything the engine and the game mode know
+// about it. Nothing else is kept between calls, so any number of boards can
+// be played at once, each on its own thread if need be. A board starts out
+// zeroed, and blockCleanup() frees what it holds.
+typedef struct Board{
+    // set before blockInitAll()
+    const struct GameMode *mode;
+    uint64_t seed;
+    int speed_init;
+
+    // When set, blockLogic() resolves every clear, fall and follow-up match in
+    // the same frame, for headless simulation. chain_count is how many match
+    // passes the last cascade took.
+    bool instant_resolve;
+    int chain_count;
+
+    // the size and rules, from the mode's setDefaults()
+    int rows;
+    int cols;
+    int num_blocks;
+    int start_rows;
+    int disabled_rows;
+    int cursor_max_x;
+    int cursor_min_y;
+    int cursor_max_y;
+    int block_move_frames;
+
+    // Both are indexed as [row][col], with all the rows of both arrays packed
+    // into a single allocation. The rows form a ring, so blockAddLayer() moves
+    // every row up by moving where row 0 starts instead of copying blocks.
+    Block **blocks;
+    BlockAnim **block_anims;
+    bool animating;
+    int bump_timer;
+    int bump_pixels;
+    int speed;
+    int speed_timer;
+    int game_over_timer;
+    int score;
+    struct Cursor cursor;
+    bool jewels_cursor_select;
+
+    // what the player is holding in drop mode
+    int drop_color;
+    int drop_amount;
+
+    // The rest is only for block.c. Each physical row appears twice in
+    // block_rows and anim_rows, so blocks can point at any of the first rows
+    // entries and still index rows rows without wrapping.
+    Block **block_rows;
+    BlockAnim **anim_rows;
+    int row_base;
+
+    // every random block comes from here, seeded from seed in blockInitAll()
+    Rng rng;
+
+    // rows whose match state changed since the last blockFindMatch3()
+    IndexSet dirty_rows;
+    bool *scan_row;
+
+    // The rows blockFindMatch3() is scanning, in order, and the matched
+    // cells it found in each
+    int *scan_list;
+    BitWord *scan_matches;
+    bool *scan_found;
+
+    // where each block in a column falls to, on boards big enough to find
+    // that on several threads
+    int *fall_from;
+    int *fall_to;
+    int *fall_count;
+
+    // cells that blockAnimate() and blockReturn() have to look at
+    IndexSet active_cells;
+    IndexSet return_cells;
+
+    // Matches waiting for blockClearMatches(). Group cells are physical cells,
+    // and the group at match_group_count is the one being filled.
+    MatchGroup *match_groups;
+    int match_group_count;
+    int *match_cells;
+    int match_cell_count;
+    bool match_overflow;
+
+    // Zobrist hash of the colors on the board, by logical row, so the same
+    // blocks hash the same however many layers were added. Each physical row
+    // keeps the hash of its own cells in row_hash, and adding a layer only
+    // combines those again under their new row numbers. hash_content is the
+    // color each physical cell was last hashed with.
+    uint64_t hash;
+    uint64_t *row_hash;
+    signed char *hash_content;
+
+    // how many blocks are stacked in each column from the bottom row up,
+    // without a gap
+    int *column_height;
+
+    // Rows waiting to be added by blockAddLayer(), generated a batch at a
+    // time ahead of the bump that needs them
+    signed char *row_queue;
+    int row_queue_head;
+    int row_queue_count;
+
+    // match passes that found something since the board was last settled
+    int chain;
+
+    // Bumped by every change to the board. If a logic pass left it alone,
+    // the next one will too, unless something else changes the board in
+    // between.
+    unsigned version;
+    unsigned idle_version;
+    bool idle_pass;
+
+    // kernels for the board's size, picked in blockSetDefaults()
+    const BlockKernels *kernels;
+
+    // work stack for blockMatchAdjacent(), one entry per cell
+    int *flood_stack;
+
+    Bitboard bitboard;
+    Plane plane;
+    Moves moves;
+}Board;
+
+int blockRand(Board *board);
+int blockRandRange(Board *board, int n);
+int blockRandExcept(Board *board, int a, int b);
+void blockSet(Board *board, int i, int j, bool alive, int color);
+void blockSetAlive(Board *board, int i, int j, bool alive, int color);
+void blockClear(Board *board, int i, int j);
+void blockSwitch(Board *board, int i, int j, int k, int l, bool animate, bool sound_after_move, EaseType ease);
+void blockSetReturn(Board *board, int i, int j, int k, int l);
+bool blockCompare(Board *board, int i, int j, int k, int l);
+void blockSetDefaults(Board *board);
+void blockCleanup(Board *board);
+void blockInitAll(Board *board);
 
-Block **blocks;
-bool animating;
-int bump_timer;
-int bump_pixels;
-int speed;
-int speed_init;
-int speed_timer;
-int game_over_timer;
-bool jewels_cursor_select;
-
-int blockRand();
-void blockSet(int i, int j, bool alive, int color);
-void blockClear(int i, int j);
-void blockSwitch(int i, int j, int k, int l, bool animate, bool sound_after_move, AHEasingFunction ease_func);
-bool blockCompare(int i, int j, int k, int l);
-void blockSetDefaults();
-void blockCleanup();
-void blockInitAll();
-
-void blockLogic();
-void blockRise();
-void blockAddFromTop();
-void blockGravity();
-void blockClearMatches();
-void blockFindMatch3();
-int blockMatchVertical(int i, int j);
-void blockMatchAdjacent(int i, int j);
-bool blockAddLayer();
-void blockReturn();
-void blockAddLayerRandom(int i);
-bool blockHasMatches();
-bool blockHasSwitchMatch();
-bool blockHasGaps();
-bool blockSwitchCursor();
-void blockGetAtMouse(int* block_x, int* block_y);
+void blockLogic(Board *board);
+int blockColumnTop(Board *board, int j);
+bool blockIsSettled(Board *board);
+int blockIdleFrames(Board *board);
+void blockSkipFrames(Board *board, int frames);
+void blockRise(Board *board);
+void blockAddFromTop(Board *board);
+void blockGravity(Board *board);
+void blockClearMatches(Board *board);
+void blockFindMatch3(Board *board);
+int blockMatchVertical(Board *board, int i, int j);
+int blockMatchAdjacent(Board *board, int i, int j);
+uint64_t blockHash(Board *board);
+int blockMatchGroupCount(Board *board);
+const MatchGroup* blockGetMatchGroup(Board *board, int n);
+void blockGetMatchCell(Board *board, const MatchGroup* group, int k, int* i, int* j);
+bool blockAddLayer(Board *board);
+void blockReturn(Board *board);
+void blockAddLayerRandom(Board *board, int i);
+void blockAddLayerQueued(Board *board, int i);
+void blockQueueFill(Board *board);
+int blockQueueCount(Board *board);
+int blockQueuePeek(Board *board, int n, int j);
+bool blockHasMatches(Board *board);
+bool blockHasSwitchMatch(Board *board);
+bool blockHasGaps(Board *board);
+bool blockSwitchCursor(Board *board);
 
 #endif
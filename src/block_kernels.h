@@ -0,0 +1,205 @@
+/*
+    FreeBlocks -  A simple puzzle game, similar to Tetris Attack
+    Copyright (C) 2012-2017 Justin Jacobs
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Board kernels for one board size. block.c includes this once for every
+// size that has its own set, with KERNEL_ROWS, KERNEL_COLS and
+// KERNEL_DISABLED_ROWS defined as constants so the compiler can unroll the
+// loops, and once more with them defined as the board's own size for every
+// other size. KERNEL_SUFFIX names the set and KERNEL_SIZE fills in its
+// rows, cols and disabled_rows. With KERNEL_ONE_WORD defined, a row fits in
+// one BitWord, and the match scans work on the bitboard's color masks a
+// whole row at a time. There's deliberately no include guard.
+
+#ifndef KERNEL_NAME
+#define KERNEL_PASTE2(name, suffix) name##_##suffix
+#define KERNEL_PASTE(name, suffix) KERNEL_PASTE2(name, suffix)
+#define KERNEL_NAME(name) KERNEL_PASTE(name, KERNEL_SUFFIX)
+#endif
+
+static void KERNEL_NAME(blockGravity)(Board *board) {
+    // compact every column in one pass, so blocks above several gaps
+    // fall all the way down at once
+    for (int j=0;j<KERNEL_COLS;j++) {
+        // the lowest empty row that the next block up can land in
+        int dest = KERNEL_ROWS-1;
+
+        for (int i=KERNEL_ROWS-1;i>=0;i--) {
+            if (!board->blocks[i][j].alive)
+                continue;
+
+            if (board->blocks[i][j].matched) {
+                // matched blocks can't be moved, so they hold up everything above them
+                dest = i-1;
+            }
+            else {
+                if (dest != i)
+                    blockSwitch(board, i,j,dest,j, true, true, EASE_SINE_IN);
+                dest--;
+            }
+        }
+    }
+}
+
+#ifdef KERNEL_ONE_WORD
+
+static BlockRowBits KERNEL_NAME(blockRowBits)(Board *board, int i) {
+    int r = i + board->bitboard.base;
+    if (r >= KERNEL_ROWS) r -= KERNEL_ROWS;
+    return blockRowBits(board, r);
+}
+
+static void KERNEL_NAME(blockMatchRows)(Board *board, int count) {
+    // Cells in each listed row that are in a horizontal run of 3 or more,
+    // or in a vertical run of 3 or more above the disabled rows. Each row's
+    // bits are only worked out once, however many listed rows look at it.
+    int last_row = KERNEL_ROWS-KERNEL_DISABLED_ROWS;
+    BlockRowBits rows[KERNEL_ROWS];
+    bool loaded[KERNEL_ROWS] = {false};
+
+    for (int n=0; n<count; n++) {
+        int i = board->scan_list[n];
+        int top = max(i-2, 0);
+        int bottom = min(i+2, last_row-1);
+        for (int k=top; k<=bottom; k++) {
+            if (!loaded[k]) {
+                rows[k] = KERNEL_NAME(blockRowBits)(board, k);
+                loaded[k] = true;
+            }
+        }
+
+        BitWord out = blockRowBitsRuns(rows[i]);
+        for (int s=top; s<=i && s+2<=bottom; s++)
+            out |= blockRowBitsEqual(rows[s], rows[s+1]) & blockRowBitsEqual(rows[s+1], rows[s+2]);
+
+        board->scan_matches[n*BITBOARD_MAX_WORDS] = out;
+        board->scan_found[n] = out != 0;
+    }
+}
+
+static bool KERNEL_NAME(blockHasMatches)(Board *board) {
+    // Check if there are any matches on the board, a row at a time from
+    // the top with the two rows above kept for the vertical runs
+    int last_row = KERNEL_ROWS-KERNEL_DISABLED_ROWS;
+    BlockRowBits above = {0, {0, 0, 0}};
+    BitWord down_above = 0;
+
+    for (int i=0;i<KERNEL_ROWS;i++) {
+        BlockRowBits row = KERNEL_NAME(blockRowBits)(board, i);
+        if (blockRowBitsRuns(row)) return true;
+
+        if (i > 0 && i < last_row) {
+            BitWord down = blockRowBitsEqual(above, row);
+            if (i > 1 && (down_above & down)) return true;
+            down_above = down;
+        }
+        above = row;
+    }
+    return false;
+}
+
+#else
+
+static void KERNEL_NAME(blockMatchRows)(Board *board, int count) {
+    // the plane checks a row many cells at a time, and big boards share
+    // the rows between threads
+    workersRun(count, board->rows*board->cols >= PARALLEL_CELLS ? PARALLEL_BAND : count, blockScanRows, board);
+}
+
+static bool KERNEL_NAME(blockHasMatches)(Board *board) {
+    // Check if there are any matches on the board
+    BitWord matches[BITBOARD_MAX_WORDS];
+
+    for (int i=0;i<KERNEL_ROWS;i++) {
+        if (planeMatchRow(&board->plane, i, 0, KERNEL_ROWS-KERNEL_DISABLED_ROWS, matches)) return true;
+    }
+    return false;
+}
+
+#endif
+
+static bool KERNEL_NAME(blockSwapRunThrough)(Board *board, const BlockSwap* swap, int i, int j) {
+    // whether (i,j) would be in a run of 3 or more with swap made
+    int key = blockSwapKey(board, swap, i, j);
+    if (key == -1) return false;
+
+    int run = 1;
+    for (int l=j-1; l>=max(j-2, 0) && blockSwapKey(board, swap, i, l) == key; l--) run++;
+    for (int l=j+1; l<=min(j+2, KERNEL_COLS-1) && blockSwapKey(board, swap, i, l) == key; l++) run++;
+    if (run >= 3) return true;
+
+    int last_row = KERNEL_ROWS-KERNEL_DISABLED_ROWS;
+    if (i >= last_row) return false;
+
+    run = 1;
+    for (int k=i-1; k>=max(i-2, 0) && blockSwapKey(board, swap, k, j) == key; k--) run++;
+    for (int k=i+1; k<=min(i+2, last_row-1) && blockSwapKey(board, swap, k, j) == key; k++) run++;
+    return run >= 3;
+}
+
+static bool KERNEL_NAME(blockSwapMatches)(Board *board, int i, int j, int k, int l) {
+    // blockSwitch() refuses to move matched blocks
+    if (board->blocks[i][j].matched || board->blocks[k][l].matched) return false;
+
+    BlockSwap swap = {i, j, k, l};
+    return KERNEL_NAME(blockSwapRunThrough)(board, &swap, i, j) ||
+        KERNEL_NAME(blockSwapRunThrough)(board, &swap, k, l);
+}
+
+static bool KERNEL_NAME(blockHasSwitchMatch)(Board *board) {
+    // Whether any switch would leave a match on the board. The switches are
+    // tried on the colors alone, so nothing on the board is touched. With
+    // no match there already, a new one has to run through a switched block.
+    if (KERNEL_NAME(blockHasMatches)(board)) return true;
+
+    for (int j=0;j<KERNEL_COLS;j++) {
+        for (int i=0;i<KERNEL_ROWS;i++) {
+            if (i+1 < KERNEL_ROWS && KERNEL_NAME(blockSwapMatches)(board, i, j, i+1, j)) return true;
+            if (j+1 < KERNEL_COLS && KERNEL_NAME(blockSwapMatches)(board, i, j, i, j+1)) return true;
+        }
+    }
+    return false;
+}
+
+static bool KERNEL_NAME(blockHasGaps)(Board *board) {
+#ifdef KERNEL_ONE_WORD
+    // the order of the rows doesn't matter here
+    for (int r=0;r<KERNEL_ROWS;r++)
+        if (board->bitboard.alive[r] != ((BitWord)1 << KERNEL_COLS) - 1) return true;
+#else
+    for (int j=0;j<KERNEL_COLS;j++)
+        for (int i=0;i<KERNEL_ROWS;i++)
+            if (!board->blocks[i][j].alive) return true;
+#endif
+    return false;
+}
+
+const BlockKernels KERNEL_NAME(block_kernels) = {
+    KERNEL_SIZE,
+    KERNEL_NAME(blockGravity),
+    KERNEL_NAME(blockMatchRows),
+    KERNEL_NAME(blockHasMatches),
+    KERNEL_NAME(blockHasSwitchMatch),
+    KERNEL_NAME(blockHasGaps),
+};
+
+#undef KERNEL_SUFFIX
+#undef KERNEL_SIZE
+#undef KERNEL_ROWS
+#undef KERNEL_COLS
+#undef KERNEL_DISABLED_ROWS
+#undef KERNEL_ONE_WORD
@@ -0,0 +1,32 @@
+/*
+    FreeBlocks -  A simple puzzle game, similar to Tetris Attack
+    Copyright (C) 2012-2017 Justin Jacobs
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stddef.h>
+
+#include "core.h"
+
+static CoreEventHandler core_event_handler = NULL;
+
+void coreSetEventHandler(CoreEventHandler handler) {
+    core_event_handler = handler;
+}
+
+void coreEvent(struct Board *board, CoreEvent core_event) {
+    if (core_event_handler)
+        core_event_handler(board, core_event);
+}
@@ -0,0 +1,54 @@
+/*
+    FreeBlocks -  A simple puzzle game, similar to Tetris Attack
+    Copyright (C) 2012-2017 Justin Jacobs
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CORE_H
+#define CORE_H
+
+#include <stdbool.h>
+
+// What the board engine and the game modes share with the rest of the game.
+// Nothing here needs SDL, so the engine can be built and run on its own.
+
+#ifdef __GCW0__
+#define HALF_GFX
+#endif
+
+#define FPS 60
+
+#ifndef min
+#define min(a, b) (((a)<(b))?(a):(b))
+#endif
+#ifndef max
+#define max(a,b) (((a)>(b))?(a):(b))
+#endif
+
+// Things that happen on the board that the player should hear about. The
+// game plays a sound for each one, and without a handler they're dropped.
+// One handler serves every board, and is told which board it came from.
+typedef enum {
+    CORE_EVENT_SWITCH, CORE_EVENT_MATCH, CORE_EVENT_DROP
+}CoreEvent;
+
+struct Board;
+
+typedef void (*CoreEventHandler)(struct Board *board, CoreEvent core_event);
+
+void coreSetEventHandler(CoreEventHandler handler);
+void coreEvent(struct Board *board, CoreEvent core_event);
+
+#endif
@@ -20,15 +20,19 @@
 
 #include "block.h"
 #include "draw.h"
+#include "game.h"
 #include "game_mode.h"
 #include "menu.h"
 #include "sys.h"
 
+int DRAW_OFFSET_X;
+int DRAW_OFFSET_Y;
+
 void drawEverything() {
     // Fill the screen with black
     SDL_RenderClear(renderer);
 
-    sysRenderImage(game_mode->background, NULL, NULL);
+    sysRenderImage(gameModeMedia(game_mode)->background, NULL, NULL);
 
     if (title_screen) {
         drawTitle();
@@ -84,48 +88,48 @@ void drawCursor() {
     if (paused) return;
 
     SDL_Rect dest;
-    dest.x = cursor.x1*BLOCK_SIZE + DRAW_OFFSET_X;
-    dest.y = (cursor.y1*BLOCK_SIZE) - bump_pixels + DRAW_OFFSET_Y;
+    dest.x = game_board.cursor.x1*BLOCK_SIZE + DRAW_OFFSET_X;
+    dest.y = (game_board.cursor.y1*BLOCK_SIZE) - game_board.bump_pixels + DRAW_OFFSET_Y;
 
     sysRenderImage(img_cursor, NULL, &dest);
 
-    if (game_mode == &game_mode_jewels && jewels_cursor_select) {
-        if (cursor.x1 > 0) {
-            dest.x = (cursor.x1-1)*BLOCK_SIZE + DRAW_OFFSET_X;
-            dest.y = (cursor.y1*BLOCK_SIZE) - bump_pixels + DRAW_OFFSET_Y;
+    if (game_mode == &game_mode_jewels && game_board.jewels_cursor_select) {
+        if (game_board.cursor.x1 > 0) {
+            dest.x = (game_board.cursor.x1-1)*BLOCK_SIZE + DRAW_OFFSET_X;
+            dest.y = (game_board.cursor.y1*BLOCK_SIZE) - game_board.bump_pixels + DRAW_OFFSET_Y;
             sysRenderImage(img_cursor_highlight, NULL, &dest);
         }
-        if (cursor.x1 < CURSOR_MAX_X) {
-            dest.x = (cursor.x1+1)*BLOCK_SIZE + DRAW_OFFSET_X;
-            dest.y = (cursor.y1*BLOCK_SIZE) - bump_pixels + DRAW_OFFSET_Y;
+        if (game_board.cursor.x1 < game_board.cursor_max_x) {
+            dest.x = (game_board.cursor.x1+1)*BLOCK_SIZE + DRAW_OFFSET_X;
+            dest.y = (game_board.cursor.y1*BLOCK_SIZE) - game_board.bump_pixels + DRAW_OFFSET_Y;
             sysRenderImage(img_cursor_highlight, NULL, &dest);
         }
-        if (cursor.y1 > CURSOR_MIN_Y) {
-            dest.x = cursor.x1*BLOCK_SIZE + DRAW_OFFSET_X;
-            dest.y = ((cursor.y1-1)*BLOCK_SIZE) - bump_pixels + DRAW_OFFSET_Y;
+        if (game_board.cursor.y1 > game_board.cursor_min_y) {
+            dest.x = game_board.cursor.x1*BLOCK_SIZE + DRAW_OFFSET_X;
+            dest.y = ((game_board.cursor.y1-1)*BLOCK_SIZE) - game_board.bump_pixels + DRAW_OFFSET_Y;
             sysRenderImage(img_cursor_highlight, NULL, &dest);
         }
-        if (cursor.y1 < CURSOR_MAX_Y) {
-            dest.x = cursor.x1*BLOCK_SIZE + DRAW_OFFSET_X;
-            dest.y = ((cursor.y1+1)*BLOCK_SIZE) - bump_pixels + DRAW_OFFSET_Y;
+        if (game_board.cursor.y1 < game_board.cursor_max_y) {
+            dest.x = game_board.cursor.x1*BLOCK_SIZE + DRAW_OFFSET_X;
+            dest.y = ((game_board.cursor.y1+1)*BLOCK_SIZE) - game_board.bump_pixels + DRAW_OFFSET_Y;
             sysRenderImage(img_cursor_highlight, NULL, &dest);
         }
     }
 
-    if (!(cursor.x1 == cursor.x2 && cursor.y1 == cursor.y2)) {
-        dest.x = cursor.x2*BLOCK_SIZE + DRAW_OFFSET_X;
-        dest.y = (cursor.y2*BLOCK_SIZE) - bump_pixels + DRAW_OFFSET_Y;
+    if (!(game_board.cursor.x1 == game_board.cursor.x2 && game_board.cursor.y1 == game_board.cursor.y2)) {
+        dest.x = game_board.cursor.x2*BLOCK_SIZE + DRAW_OFFSET_X;
+        dest.y = (game_board.cursor.y2*BLOCK_SIZE) - game_board.bump_pixels + DRAW_OFFSET_Y;
         sysRenderImage(img_cursor, NULL, &dest);
     }
 
     if (game_mode == &game_mode_drop) {
         int drop_color, drop_amount;
-        game_mode->getHeld(&drop_color, &drop_amount);
+        game_mode->getHeld(&game_board, &drop_color, &drop_amount);
 
         if (drop_color != -1) {
             SDL_Rect src;
 
-            dest.x = cursor.x1 * BLOCK_SIZE + DRAW_OFFSET_X;
+            dest.x = game_board.cursor.x1 * BLOCK_SIZE + DRAW_OFFSET_X;
             dest.y = DRAW_OFFSET_Y - BLOCK_SIZE;
 
             src.x = drop_color * BLOCK_SIZE;
@@ -142,7 +146,7 @@ void drawCursor() {
 
                 text = createText(amount_str, &color);
                 if(text) {
-                    dest.x = (cursor.x1*BLOCK_SIZE) + DRAW_OFFSET_X + (BLOCK_SIZE/2) - (text->w/2);
+                    dest.x = (game_board.cursor.x1*BLOCK_SIZE) + DRAW_OFFSET_X + (BLOCK_SIZE/2) - (text->w/2);
                     dest.y = DRAW_OFFSET_Y - BLOCK_SIZE + (BLOCK_SIZE/2) - (text->h/2);
                     sysRenderImage(text, NULL, &dest);
                     sysDestroyImage(&text);
@@ -159,25 +163,32 @@ void drawBlocks() {
 
     int i,j;
 
-    for(i=0;i<ROWS;i++) {
-        for(j=0;j<COLS;j++) {
-            if(blocks[i][j].alive) {
+    // only draw the part of the board that's on screen, plus a block on
+    // each side for the ones that are moving in
+    int first_row = max((game_board.bump_pixels - DRAW_OFFSET_Y) / BLOCK_SIZE - 1, 0);
+    int last_row = min((SCREEN_HEIGHT + game_board.bump_pixels - DRAW_OFFSET_Y) / BLOCK_SIZE + 1, game_board.rows-1);
+    int first_col = max(-DRAW_OFFSET_X / BLOCK_SIZE - 1, 0);
+    int last_col = min((SCREEN_WIDTH - DRAW_OFFSET_X) / BLOCK_SIZE + 1, game_board.cols-1);
+
+    for(i=first_row;i<=last_row;i++) {
+        for(j=first_col;j<=last_col;j++) {
+            if(game_board.blocks[i][j].alive) {
                 SDL_Rect src,dest;
 
-                dest.x = blocks[i][j].x + DRAW_OFFSET_X;
-                dest.y = blocks[i][j].y - bump_pixels + DRAW_OFFSET_Y;
+                dest.x = j*BLOCK_SIZE + game_board.block_anims[i][j].offset_x + DRAW_OFFSET_X;
+                dest.y = i*BLOCK_SIZE + game_board.block_anims[i][j].offset_y - game_board.bump_pixels + DRAW_OFFSET_Y;
 
-                if (blocks[i][j].matched) {
-                    src.x = blocks[i][j].frame * BLOCK_SIZE;
+                if (game_board.blocks[i][j].matched) {
+                    src.x = game_board.blocks[i][j].frame * BLOCK_SIZE;
                     src.y = 0;
 
                     src.w = src.h = BLOCK_SIZE;
 
                     sysRenderImage(img_clear, &src, &dest);
                 } else {
-                    src.x = blocks[i][j].color * BLOCK_SIZE;
+                    src.x = game_board.blocks[i][j].color * BLOCK_SIZE;
 
-                    if (i > ROWS-1-DISABLED_ROWS || game_over || game_over_timer > 0) src.y = BLOCK_SIZE;
+                    if (i > game_board.rows-1-game_board.disabled_rows || game_over || game_board.game_over_timer > 0) src.y = BLOCK_SIZE;
                     else src.y = 0;
 
                     src.w = src.h = BLOCK_SIZE;
@@ -198,15 +209,17 @@ void drawInfo() {
     // statusbar background
     dest.x = 0;
     dest.y = SCREEN_HEIGHT - img_bar->h;
-    if (paused || game_over || game_over_timer > 0) sysRenderImage(img_bar_inactive, NULL, &dest);
+    if (paused || game_over || game_board.game_over_timer > 0) sysRenderImage(img_bar_inactive, NULL, &dest);
     else sysRenderImage(img_bar, NULL, &dest);
 
+    if (!paused && !game_over && game_board.game_over_timer == 0) drawPreview();
+
     // statusbar text
-    if (game_over || game_over_timer > 0) sprintf(text,"Score: %-10d  Game Over!",score);
+    if (game_over || game_board.game_over_timer > 0) sprintf(text,"Score: %-10d  Game Over!",game_board.score);
     else {
-        if (paused) sprintf(text,"Score: %-10d  *Paused*",score);
+        if (paused) sprintf(text,"Score: %-10d  *Paused*",game_board.score);
         else {
-            game_mode->statusText(text, score, speed);
+            game_mode->statusText(text, game_board.score, game_board.speed);
         }
     }
 
@@ -224,6 +237,30 @@ void drawInfo() {
     if (paused || game_over) drawMenu(img_bar->h);
 }
 
+void drawPreview() {
+    // The next row to come up after the disabled one, drawn as a thin slice
+    // of each block along the bottom of the status bar, under its column
+    if (blockQueueCount(&game_board) == 0) return;
+
+    int h = BLOCK_SIZE/8;
+    int first_col = max(-DRAW_OFFSET_X / BLOCK_SIZE, 0);
+    int last_col = min((SCREEN_WIDTH - DRAW_OFFSET_X) / BLOCK_SIZE, game_board.cols-1);
+
+    for (int j=first_col; j<=last_col; j++) {
+        SDL_Rect src,dest;
+
+        src.x = blockQueuePeek(&game_board, 0, j) * BLOCK_SIZE;
+        src.y = (BLOCK_SIZE - h) / 2;
+        src.w = BLOCK_SIZE;
+        src.h = h;
+
+        dest.x = j*BLOCK_SIZE + DRAW_OFFSET_X;
+        dest.y = SCREEN_HEIGHT - h;
+
+        sysRenderImage(img_blocks, &src, &dest);
+    }
+}
+
 void drawTitle() {
     SDL_Rect dest;
 
@@ -308,3 +345,41 @@ Image* createText(const char* text, const SDL_Color* color) {
     }
     return NULL;
 }
+
+void drawInitView() {
+    // center the board, then scroll it to the cursor if it doesn't fit
+    DRAW_OFFSET_X = (SCREEN_WIDTH - game_board.cols * BLOCK_SIZE) / 2;
+    DRAW_OFFSET_Y = (SCREEN_HEIGHT - game_board.rows * BLOCK_SIZE) / 2;
+
+    // We need to change our vertical offset if the block size != status bar size
+    DRAW_OFFSET_Y += gameModeMedia(game_mode)->drawOffsetExtraY;
+
+    drawUpdateView();
+}
+
+void drawUpdateView() {
+    // Boards bigger than the screen scroll to keep the cursor in view. The
+    // offsets only change when the cursor gets close to an edge, so moving
+    // the mouse near the edge of the board scrolls it.
+    int view_w = SCREEN_WIDTH;
+    int view_h = SCREEN_HEIGHT - img_bar->h;
+    int margin = BLOCK_SIZE*2;
+
+    if (game_board.cols*BLOCK_SIZE > view_w) {
+        int x = game_board.cursor.x1*BLOCK_SIZE + DRAW_OFFSET_X;
+        if (x < margin)
+            DRAW_OFFSET_X += margin - x;
+        else if (x + 2*BLOCK_SIZE > view_w - margin)
+            DRAW_OFFSET_X -= x + 2*BLOCK_SIZE - (view_w - margin);
+        DRAW_OFFSET_X = max(min(DRAW_OFFSET_X, 0), view_w - game_board.cols*BLOCK_SIZE);
+    }
+
+    if (game_board.rows*BLOCK_SIZE > view_h) {
+        int y = game_board.cursor.y1*BLOCK_SIZE - game_board.bump_pixels + DRAW_OFFSET_Y;
+        if (y < margin)
+            DRAW_OFFSET_Y += margin - y;
+        else if (y + BLOCK_SIZE > view_h - margin)
+            DRAW_OFFSET_Y -= y + BLOCK_SIZE - (view_h - margin);
+        DRAW_OFFSET_Y = max(min(DRAW_OFFSET_Y, 0), view_h - game_board.rows*BLOCK_SIZE + game_board.bump_pixels);
+    }
+}
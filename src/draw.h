@@ -19,11 +19,19 @@
 #ifndef DRAW_H
 #define DRAW_H
 
+#include "sys.h"
+
+extern int DRAW_OFFSET_X;
+extern int DRAW_OFFSET_Y;
+
+void drawInitView();
+void drawUpdateView();
 void drawEverything();
 void drawMenu(int offset);
 void drawCursor();
 void drawBlocks();
 void drawInfo();
+void drawPreview();
 void drawTitle();
 void drawHighScores();
 void drawOptions();
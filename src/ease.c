@@ -0,0 +1,101 @@
+/*
+    FreeBlocks -  A simple puzzle game, similar to Tetris Attack
+    Copyright (C) 2012-2017 Justin Jacobs
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdbool.h>
+
+#include "ease.h"
+
+// sin(k/64 * PI/2) for k = 0..64, in 16.16 fixed point. Every curve is built
+// from this table with integer math, so positions are the same on every
+// platform no matter how its FPU rounds.
+#define QUARTER_SINE_STEPS 64
+static const int quarter_sine[QUARTER_SINE_STEPS+1] = {
+    0, 1608, 3216, 4821, 6424, 8022, 9616, 11204,
+    12785, 14359, 15924, 17479, 19024, 20557, 22078, 23586,
+    25080, 26558, 28020, 29466, 30893, 32303, 33692, 35062,
+    36410, 37736, 39040, 40320, 41576, 42806, 44011, 45190,
+    46341, 47464, 48559, 49624, 50660, 51665, 52639, 53581,
+    54491, 55368, 56212, 57022, 57798, 58538, 59244, 59914,
+    60547, 61145, 61705, 62228, 62714, 63162, 63572, 63944,
+    64277, 64571, 64827, 65043, 65220, 65358, 65457, 65516,
+    65536,
+};
+
+// The tables for each length are packed one after another, and the one for
+// length n holds the progress after 0..n of n frames
+#define EASE_TABLE_SIZE ((EASE_MAX_LENGTH-1)*(EASE_MAX_LENGTH+2)/2 + EASE_MAX_LENGTH+1)
+static int ease_tables[EASE_COUNT][EASE_TABLE_SIZE];
+static bool ease_built = false;
+
+static int easeTableOffset(int length) {
+    return (length-1)*(length+2)/2;
+}
+
+static int easeQuarterSine(int p) {
+    // sin(p * PI/2) for p in [0, EASE_ONE]
+    int pos = p * QUARTER_SINE_STEPS;
+    int k = pos >> EASE_SHIFT;
+    int frac = pos & (EASE_ONE - 1);
+
+    if (k >= QUARTER_SINE_STEPS) return quarter_sine[QUARTER_SINE_STEPS];
+    return quarter_sine[k] + (((quarter_sine[k+1] - quarter_sine[k]) * frac) >> EASE_SHIFT);
+}
+
+static int easeCurve(EaseType ease, int p) {
+    switch (ease) {
+    case EASE_SINE_IN:
+        // 1 - cos(p * PI/2)
+        return EASE_ONE - easeQuarterSine(EASE_ONE - p);
+    case EASE_SINE_OUT:
+        // sin(p * PI/2)
+        return easeQuarterSine(p);
+    case EASE_SINE_IN_OUT:
+        // (1 - cos(p * PI)) / 2
+        if (p < EASE_ONE/2)
+            return (EASE_ONE - easeQuarterSine(EASE_ONE - 2*p)) / 2;
+        else
+            return (EASE_ONE + easeQuarterSine(2*p - EASE_ONE)) / 2;
+    case EASE_LINEAR:
+    default:
+        return p;
+    }
+}
+
+void easeInit() {
+    if (ease_built) return;
+
+    for (int e=0; e<EASE_COUNT; e++) {
+        for (int length=1; length<=EASE_MAX_LENGTH; length++) {
+            int* table = ease_tables[e] + easeTableOffset(length);
+            for (int n=0; n<=length; n++) {
+                table[n] = easeCurve(e, (int)(((long long)n << EASE_SHIFT) / length));
+            }
+        }
+    }
+    ease_built = true;
+}
+
+int easeStep(EaseType ease, int step, int length) {
+    if (step >= length) return EASE_ONE;
+    if (step <= 0) return 0;
+
+    if (!ease_built || length > EASE_MAX_LENGTH)
+        return easeCurve(ease, (int)(((long long)step << EASE_SHIFT) / length));
+
+    return ease_tables[ease][easeTableOffset(length) + step];
+}
@@ -0,0 +1,39 @@
+/*
+    FreeBlocks -  A simple puzzle game, similar to Tetris Attack
+    Copyright (C) 2012-2017 Justin Jacobs
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef EASE_H
+#define EASE_H
+
+// Fixed-point versions of the easing curves used for block movement.
+// Progress is returned in 16.16 fixed point, so 1 << EASE_SHIFT is done.
+#define EASE_SHIFT 16
+#define EASE_ONE (1 << EASE_SHIFT)
+
+typedef enum {
+    EASE_LINEAR, EASE_SINE_IN, EASE_SINE_OUT, EASE_SINE_IN_OUT, EASE_COUNT
+}EaseType;
+
+// Tables for every move up to EASE_MAX_LENGTH frames, built once by
+// easeInit() before any board runs and only read after that, so every board
+// on every thread shares them. Longer moves work out the same curve directly.
+#define EASE_MAX_LENGTH 128
+
+void easeInit();
+int easeStep(EaseType ease, int step, int length);
+
+#endif
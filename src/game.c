@@ -19,11 +19,63 @@
 #include <stdlib.h>
 
 #include "block.h"
+#include "draw.h"
 #include "game.h"
 #include "game_mode.h"
 #include "menu.h"
 #include "sys.h"
 
+const GameMode *game_mode;
+Board game_board;
+
+bool cursor_moving;
+int cursor_timer;
+int rebind_index;
+
+static GameModeMedia game_mode_media[GAME_MODE_COUNT];
+
+void gameInitModes() {
+    // the engine has the rules of each mode, and this is how the game looks
+    // and sounds in it
+    game_mode_media[GAME_MODE_DEFAULT].drawOffsetExtraY = BLOCK_SIZE-(img_bar->h);
+    game_mode_media[GAME_MODE_DEFAULT].background = img_background;
+    game_mode_media[GAME_MODE_DEFAULT].music = music;
+    game_mode_media[GAME_MODE_DEFAULT].highscores = &path_file_highscores;
+
+    game_mode_media[GAME_MODE_JEWELS].drawOffsetExtraY = 0;
+    game_mode_media[GAME_MODE_JEWELS].background = img_background_jewels;
+    game_mode_media[GAME_MODE_JEWELS].music = music_jewels;
+    game_mode_media[GAME_MODE_JEWELS].highscores = &path_file_highscores_jewels;
+
+    game_mode_media[GAME_MODE_DROP].drawOffsetExtraY = BLOCK_SIZE-(img_bar->h)+(BLOCK_SIZE/2);
+    game_mode_media[GAME_MODE_DROP].background = img_background_drop;
+    game_mode_media[GAME_MODE_DROP].music = music;
+    game_mode_media[GAME_MODE_DROP].highscores = &path_file_highscores_drop;
+
+    game_mode_media[GAME_MODE_MARATHON].drawOffsetExtraY = BLOCK_SIZE-(img_bar->h);
+    game_mode_media[GAME_MODE_MARATHON].background = img_background;
+    game_mode_media[GAME_MODE_MARATHON].music = music;
+    game_mode_media[GAME_MODE_MARATHON].highscores = &path_file_highscores_marathon;
+}
+
+GameModeMedia* gameModeMedia(const GameMode *mode) {
+    return &game_mode_media[gameModeGetIndex(mode)];
+}
+
+void gamePlaySound(Board *board, CoreEvent core_event) {
+    switch (core_event) {
+    case CORE_EVENT_SWITCH:
+        Mix_PlayChannel(-1,sound_switch,0);
+        break;
+    case CORE_EVENT_MATCH:
+        Mix_PlayChannel(-1,sound_match,0);
+        break;
+    case CORE_EVENT_DROP:
+        Mix_PlayChannel(-1,sound_drop,0);
+        break;
+    }
+}
+
 void gameTitle() {
     title_screen = true;
     high_scores_screen = false;
@@ -31,11 +83,11 @@ void gameTitle() {
     rebind_index = -1;
 
     game_over = false;
-    score = 0;
+    game_board.score = 0;
     Mix_FadeOutMusic(2000);
 
     menuAdd("Play Game", 0, 0);
-    menuAdd("Game Type", GAME_MODE_DEFAULT, GAME_MODE_DROP);
+    menuAdd("Game Type", GAME_MODE_DEFAULT, GAME_MODE_MARATHON);
     menuAdd("Speed Level", 1, MAX_SPEED);
     menuAdd("High Scores", 0, 0);
     menuAdd("Options", 0, 0);
@@ -46,7 +98,8 @@ void gameTitle() {
     menuItemSetOptionText(1, GAME_MODE_DEFAULT, "Normal");
     menuItemSetOptionText(1, GAME_MODE_JEWELS, "Jewels");
     menuItemSetOptionText(1, GAME_MODE_DROP, "Drop");
-    menuItemSetVal(1, gameModeGetIndex());
+    menuItemSetOptionText(1, GAME_MODE_MARATHON, "Marathon");
+    menuItemSetVal(1, gameModeGetIndex(game_mode));
 }
 
 void gameHighScores() {
@@ -154,20 +207,23 @@ void gameOptionsRebind() {
 
 void gameInit() {
     title_screen = false;
-    score = 0;
     cursor_moving = false;
     cursor_timer = -1;
 
     sysHighScoresLoad();
 
-    blockInitAll();
-    cursor.x1 = (COLS/2)-1;
-    cursor.y1 = ROWS-START_ROWS;
-    if (cursor.y1 > CURSOR_MAX_Y) cursor.y1 = CURSOR_MAX_Y;
+    // each game gets its own seed, so it can be replayed from it
+    game_board.mode = game_mode;
+    game_board.seed = ((uint64_t)rand() << 32) ^ (uint64_t)rand();
+    blockInitAll(&game_board);
+    game_board.cursor.x1 = (game_board.cols/2)-1;
+    game_board.cursor.y1 = game_board.rows-game_board.start_rows;
+    if (game_board.cursor.y1 > game_board.cursor_max_y) game_board.cursor.y1 = game_board.cursor_max_y;
+    drawInitView();
 
     Mix_VolumeMusic(option_music*16);
     if (!game_over) {
-        Mix_PlayMusic(game_mode->music,-1);
+        Mix_PlayMusic(gameModeMedia(game_mode)->music,-1);
     }
 
     game_over = false;
@@ -197,13 +253,14 @@ void gameLogic() {
         case GAME_MODE_DEFAULT: game_mode = &game_mode_default; break;
         case GAME_MODE_JEWELS: game_mode = &game_mode_jewels; break;
         case GAME_MODE_DROP: game_mode = &game_mode_drop; break;
+        case GAME_MODE_MARATHON: game_mode = &game_mode_marathon; break;
         }
 
         menuItemSetEnabled(2, game_mode->speed);
 
         if (menu_choice > -1) {
             // get the "Speed Level" value
-            speed_init = menuItemGetVal(2);
+            game_board.speed_init = menuItemGetVal(2);
 
             menuClear();
             if (menu_choice == 0) gameInit();
@@ -333,10 +390,10 @@ void gameLogic() {
         if (menu_choice > -1) {
             menuClear();
             if (menu_choice == 0) {
-                gameAddHighScore(score);
+                gameAddHighScore(game_board.score);
                 gameInit();
             } else if (menu_choice == 1) {
-                gameAddHighScore(score);
+                gameAddHighScore(game_board.score);
                 gameTitle();
             }
         }
@@ -344,7 +401,7 @@ void gameLogic() {
     }
 
     // handle gameplay input
-    if (game_over_timer > 0) {
+    if (game_board.game_over_timer > 0) {
         gameOver();
     } else {
         gamePause(); // check if the pause key is pressed
@@ -365,13 +422,14 @@ void gameLogic() {
                     Mix_VolumeMusic(option_music*16);
                 } else if (menu_choice == 1) {
                     paused = false;
-                    gameAddHighScore(score);
+                    gameAddHighScore(game_board.score);
                     gameTitle();
                 }
             }
         } else {
-            blockLogic();
+            blockLogic(&game_board);
             gameMove();
+            drawUpdateView();
             gameSwitch();
             gamePickUp();
             gameBump();
@@ -379,41 +437,69 @@ void gameLogic() {
     }
 }
 
+static void gameGetBlockAtMouse(int* block_x, int* block_y) {
+    if (!block_x || !block_y) return;
+
+    *block_x = -1;
+    *block_y = -1;
+
+    int mx = mouse_x;
+    int my = mouse_y;
+
+    if (game_mode == &game_mode_default || game_mode == &game_mode_marathon)
+        mx -= (BLOCK_SIZE/2);
+
+    if (mx < DRAW_OFFSET_X)
+        return;
+
+    if (my < DRAW_OFFSET_Y)
+        return;
+
+    int x = (mx - DRAW_OFFSET_X) / BLOCK_SIZE;
+    int y = (my - DRAW_OFFSET_Y + game_board.bump_pixels) / BLOCK_SIZE;
+
+    if (x >= 0 && x <= game_board.cursor_max_x)
+        *block_x = x;
+
+    if (y >= game_board.cursor_min_y && y <= game_board.cursor_max_y)
+        *block_y = y;
+}
+
 void gameMove() {
     cursor_moving = false;
-    if (cursor.y1 < CURSOR_MIN_Y) cursor.y1 = CURSOR_MIN_Y;
+    if (game_board.cursor.y1 < game_board.cursor_min_y) game_board.cursor.y1 = game_board.cursor_min_y;
     if (action_move != action_last_move) cursor_timer = -1;
     if (action_move == action_last_move && action_cooldown > 0) return;
 
-    struct Cursor cursor_prev = cursor;
-    if (game_mode == &game_mode_jewels && jewels_cursor_select) {
+    struct Cursor cursor_prev = game_board.cursor;
+    if (game_mode == &game_mode_jewels && game_board.jewels_cursor_select) {
         switch (action_move) {
         case ACTION_LEFT:
-            if (cursor.x1 > 0) {
-                cursor.x2 = cursor.x1 - 1;
-                cursor.y2 = cursor.y1;
-                game_mode->doSwitch();
+            if (game_board.cursor.x1 > 0) {
+                game_board.cursor.x2 = game_board.cursor.x1 - 1;
+                game_board.cursor.y2 = game_board.cursor.y1;
+                game_mode->doSwitch(&game_board);
             }
             break;
         case ACTION_RIGHT:
-            if (cursor.x1 < CURSOR_MAX_X) {
-                cursor.x2 = cursor.x1 + 1;
-                cursor.y2 = cursor.y1;
-                game_mode->doSwitch();
+            if (game_board.cursor.x1 < game_board.cursor_max_x) {
+                game_board.cursor.x2 = game_board.cursor.x1 + 1;
+                game_board.cursor.y2 = game_board.cursor.y1;
+                game_mode->doSwitch(&game_board);
             }
             break;
         case ACTION_UP:
-            if (cursor.y1 > CURSOR_MIN_Y) {
-                cursor.y2 = cursor.y1 - 1;
-                cursor.x2 = cursor.x1;
-                game_mode->doSwitch();
+            if (game_board.cursor.y1 > game_board.cursor_min_y) {
+                game_board.cursor.y2 = game_board.cursor.y1 - 1;
+                game_board.cursor.x2 = game_board.cursor.x1;
+                game_mode->doSwitch(&game_board);
             }
             break;
         case ACTION_DOWN:
-            if (cursor.y1 < CURSOR_MAX_Y) {
-                cursor.y2 = cursor.y1 + 1;
-                cursor.x2 = cursor.x1;
-                game_mode->doSwitch();
+            if (game_board.cursor.y1 < game_board.cursor_max_y) {
+                game_board.cursor.y2 = game_board.cursor.y1 + 1;
+                game_board.cursor.x2 = game_board.cursor.x1;
+                game_mode->doSwitch(&game_board);
             }
             break;
         case ACTION_NONE:
@@ -425,23 +511,23 @@ void gameMove() {
     else {
         switch (action_move) {
         case ACTION_LEFT:
-            if (cursor.x1 > 0) {
-                cursor.x1--;
+            if (game_board.cursor.x1 > 0) {
+                game_board.cursor.x1--;
             }
             break;
         case ACTION_RIGHT:
-            if (cursor.x1 < CURSOR_MAX_X) {
-                cursor.x1++;
+            if (game_board.cursor.x1 < game_board.cursor_max_x) {
+                game_board.cursor.x1++;
             }
             break;
         case ACTION_UP:
-            if (cursor.y1 > CURSOR_MIN_Y) {
-                cursor.y1--;
+            if (game_board.cursor.y1 > game_board.cursor_min_y) {
+                game_board.cursor.y1--;
             }
             break;
         case ACTION_DOWN:
-            if (cursor.y1 < CURSOR_MAX_Y) {
-                cursor.y1++;
+            if (game_board.cursor.y1 < game_board.cursor_max_y) {
+                game_board.cursor.y1++;
             }
             break;
         case ACTION_NONE:
@@ -450,17 +536,17 @@ void gameMove() {
     }
 
     int bx = -1, by = -1;
-    if (mouse_moving && !(game_mode == &game_mode_jewels && jewels_cursor_select)) {
-        blockGetAtMouse(&bx, &by);
+    if (mouse_moving && !(game_mode == &game_mode_jewels && game_board.jewels_cursor_select)) {
+        gameGetBlockAtMouse(&bx, &by);
         if (bx != -1 && by != -1) {
-            cursor.x1 = bx;
-            cursor.y1 = by;
+            game_board.cursor.x1 = bx;
+            game_board.cursor.y1 = by;
         }
     }
 
-    game_mode->setCursor();
+    game_mode->setCursor(&game_board);
 
-    cursor_moving = cursor_prev.x1 != cursor.x1 || cursor_prev.y1 != cursor.y1;
+    cursor_moving = cursor_prev.x1 != game_board.cursor.x1 || cursor_prev.y1 != game_board.cursor.y1;
 
     if (cursor_moving) {
         Mix_PlayChannel(-1,sound_switch,0);
@@ -490,79 +576,79 @@ void gameMove() {
 
 void gameSwitch() {
     if (action_switch) {
-        game_mode->doSwitch();
+        game_mode->doSwitch(&game_board);
         action_switch = false;
     }
     else if (action_click) {
         // TODO some of this stuff should probably be in gameMove()
         int bx, by;
-        blockGetAtMouse(&bx, &by);
+        gameGetBlockAtMouse(&bx, &by);
 
         if (bx != -1 && by != -1) {
-            if (game_mode == &game_mode_jewels && jewels_cursor_select) {
-                if (bx == cursor.x1 && by == cursor.y1-1) {
-                    cursor.x2 = cursor.x1;
-                    cursor.y2 = cursor.y1-1;
-                    game_mode->doSwitch();
+            if (game_mode == &game_mode_jewels && game_board.jewels_cursor_select) {
+                if (bx == game_board.cursor.x1 && by == game_board.cursor.y1-1) {
+                    game_board.cursor.x2 = game_board.cursor.x1;
+                    game_board.cursor.y2 = game_board.cursor.y1-1;
+                    game_mode->doSwitch(&game_board);
                     Mix_PlayChannel(-1,sound_switch,0);
                 }
-                else if (bx == cursor.x1 && by == cursor.y1+1) {
-                    cursor.x2 = cursor.x1;
-                    cursor.y2 = cursor.y1+1;
-                    game_mode->doSwitch();
+                else if (bx == game_board.cursor.x1 && by == game_board.cursor.y1+1) {
+                    game_board.cursor.x2 = game_board.cursor.x1;
+                    game_board.cursor.y2 = game_board.cursor.y1+1;
+                    game_mode->doSwitch(&game_board);
                     Mix_PlayChannel(-1,sound_switch,0);
                 }
-                else if (bx == cursor.x1-1 && by == cursor.y1) {
-                    cursor.x2 = cursor.x1-1;
-                    cursor.y2 = cursor.y1;
-                    game_mode->doSwitch();
+                else if (bx == game_board.cursor.x1-1 && by == game_board.cursor.y1) {
+                    game_board.cursor.x2 = game_board.cursor.x1-1;
+                    game_board.cursor.y2 = game_board.cursor.y1;
+                    game_mode->doSwitch(&game_board);
                     Mix_PlayChannel(-1,sound_switch,0);
                 }
-                else if (bx == cursor.x1+1 && by == cursor.y1) {
-                    cursor.x2 = cursor.x1+1;
-                    cursor.y2 = cursor.y1;
-                    game_mode->doSwitch();
+                else if (bx == game_board.cursor.x1+1 && by == game_board.cursor.y1) {
+                    game_board.cursor.x2 = game_board.cursor.x1+1;
+                    game_board.cursor.y2 = game_board.cursor.y1;
+                    game_mode->doSwitch(&game_board);
                     Mix_PlayChannel(-1,sound_switch,0);
                 }
-                else if (bx == cursor.x1 && by == cursor.y1) {
-                    jewels_cursor_select = !jewels_cursor_select;
+                else if (bx == game_board.cursor.x1 && by == game_board.cursor.y1) {
+                    game_board.jewels_cursor_select = !game_board.jewels_cursor_select;
                     Mix_PlayChannel(-1,sound_switch,0);
                 }
-                else if (!(bx == cursor.x1 && by == cursor.y1)) {
-                    cursor.x1 = cursor.x2 = bx;
-                    cursor.y1 = cursor.y2 = by;
-                    jewels_cursor_select = true;
+                else if (!(bx == game_board.cursor.x1 && by == game_board.cursor.y1)) {
+                    game_board.cursor.x1 = game_board.cursor.x2 = bx;
+                    game_board.cursor.y1 = game_board.cursor.y2 = by;
+                    game_board.jewels_cursor_select = true;
                     Mix_PlayChannel(-1,sound_switch,0);
                 }
             }
-            else if (game_mode == &game_mode_default || (game_mode == &game_mode_jewels && !jewels_cursor_select)) {
-                if (!(bx == cursor.x1 && by == cursor.y1)) {
-                    cursor.x1 = bx;
-                    cursor.x2 = (game_mode == &game_mode_jewels) ? bx : bx+1;
-                    cursor.y1 = cursor.y2 = by;
+            else if (game_mode == &game_mode_default || game_mode == &game_mode_marathon || (game_mode == &game_mode_jewels && !game_board.jewels_cursor_select)) {
+                if (!(bx == game_board.cursor.x1 && by == game_board.cursor.y1)) {
+                    game_board.cursor.x1 = bx;
+                    game_board.cursor.x2 = (game_mode == &game_mode_jewels) ? bx : bx+1;
+                    game_board.cursor.y1 = game_board.cursor.y2 = by;
 
                     if (game_mode == &game_mode_jewels)
-                        jewels_cursor_select = true;
+                        game_board.jewels_cursor_select = true;
 
                     Mix_PlayChannel(-1,sound_switch,0);
                 }
                 else {
                     if (game_mode == &game_mode_jewels)
-                        jewels_cursor_select = !jewels_cursor_select;
+                        game_board.jewels_cursor_select = !game_board.jewels_cursor_select;
                     else
-                        game_mode->doSwitch();
+                        game_mode->doSwitch(&game_board);
 
                     Mix_PlayChannel(-1,sound_switch,0);
                 }
             }
             else if (game_mode == &game_mode_drop) {
                 int drop_amount;
-                game_mode->getHeld(NULL, &drop_amount);
+                game_mode->getHeld(&game_board, NULL, &drop_amount);
 
-                if (drop_amount == 0 || (bx == cursor.x1 && by == cursor.y1 && blocks[by][bx].alive))
-                    game_mode->pickUp();
+                if (drop_amount == 0 || (bx == game_board.cursor.x1 && by == game_board.cursor.y1 && game_board.blocks[by][bx].alive))
+                    game_mode->pickUp(&game_board);
                 else
-                    game_mode->doSwitch();
+                    game_mode->doSwitch(&game_board);
             }
 
             action_click = false;
@@ -572,21 +658,21 @@ void gameSwitch() {
                 SDL_Rect r;
                 r.x = DRAW_OFFSET_X;
                 r.y = DRAW_OFFSET_Y - BLOCK_SIZE;
-                r.w = BLOCK_SIZE*COLS;
+                r.w = BLOCK_SIZE*game_board.cols;
                 r.h = BLOCK_SIZE;
 
                 if (mouse_x >= r.x && mouse_x < r.x+r.w && mouse_y >= r.y && mouse_y < r.y+r.h) {
                     SDL_Rect r2;
-                    r2.x = cursor.x1 * BLOCK_SIZE + DRAW_OFFSET_X;
+                    r2.x = game_board.cursor.x1 * BLOCK_SIZE + DRAW_OFFSET_X;
                     r2.y = r.y;
                     r2.w = r2.h = r.h;
 
                     if (mouse_x >= r2.x && mouse_x < r2.x+r2.w && mouse_y >= r2.y && mouse_y < r2.y+r2.h) {
-                        game_mode->doSwitch();
+                        game_mode->doSwitch(&game_board);
                     }
                     else {
-                        cursor.x1 = (mouse_x  - DRAW_OFFSET_X) / BLOCK_SIZE;
-                        game_mode->setCursor();
+                        game_board.cursor.x1 = (mouse_x  - DRAW_OFFSET_X) / BLOCK_SIZE;
+                        game_mode->setCursor(&game_board);
                     }
 
                     action_click = false;
@@ -598,15 +684,15 @@ void gameSwitch() {
 
 void gameBump() {
     if (action_bump || action_right_click) {
-        game_mode->bump();
+        game_mode->bump(&game_board);
         action_bump = false;
         action_right_click = false;
     }
     else if (action_click) {
-        if (game_mode == &game_mode_default || game_mode == &game_mode_drop) {
-            if (mouse_y > SCREEN_HEIGHT - img_bar->h - bump_pixels) {
-                if (blockAddLayer())
-                    score += POINTS_PER_BUMP;
+        if (game_mode == &game_mode_default || game_mode == &game_mode_marathon || game_mode == &game_mode_drop) {
+            if (mouse_y > SCREEN_HEIGHT - img_bar->h - game_board.bump_pixels) {
+                if (blockAddLayer(&game_board))
+                    game_board.score += POINTS_PER_BUMP;
                 action_click = false;
             }
         }
@@ -615,15 +701,15 @@ void gameBump() {
 
 void gamePickUp() {
     if (action_pickup) {
-        game_mode->pickUp();
+        game_mode->pickUp(&game_board);
         action_pickup = false;
     }
 }
 
 void gameOver() {
-    game_over_timer--;
+    game_board.game_over_timer--;
 
-    if (game_over_timer == 0) {
+    if (game_board.game_over_timer == 0) {
         game_over = true;
         menuAdd("Try again", 0, 0);
         menuAdd("Return to title screen", 0, 0);
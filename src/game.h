@@ -19,12 +19,30 @@
 #ifndef GAME_H
 #define GAME_H
 
+#include "block.h"
+#include "game_mode.h"
 #include "sys.h"
 
-bool cursor_moving;
-int cursor_timer;
-int rebind_index;
-
+// How the game shows a mode and where its high scores go, which the engine
+// doesn't know about
+typedef struct GameModeMedia{
+    int drawOffsetExtraY;
+    Image *background;
+    Mix_Music *music;
+    String *highscores;
+}GameModeMedia;
+
+// the mode picked on the title screen, and the board it's played on
+extern const GameMode *game_mode;
+extern Board game_board;
+
+extern bool cursor_moving;
+extern int cursor_timer;
+extern int rebind_index;
+
+void gameInitModes();
+GameModeMedia* gameModeMedia(const GameMode *mode);
+void gamePlaySound(Board *board, CoreEvent core_event);
 void gameTitle();
 void gameHighScores();
 void gameOptions();
@@ -16,171 +16,229 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <stdio.h>
+
 #include "game_mode.h"
 #include "block.h"
 
-static void defaultSetDefaults();
-static void jewelsSetDefaults();
-static void dropSetDefaults();
-static void defaultInitAll();
-static void jewelsInitAll();
-static void dropInitAll();
-static void defaultBlockLogic();
-static void jewelsBlockLogic();
-static void dropBlockLogic();
+static void defaultSetDefaults(Board *board);
+static void jewelsSetDefaults(Board *board);
+static void dropSetDefaults(Board *board);
+static void marathonSetDefaults(Board *board);
+static void defaultInitAll(Board *board);
+static void jewelsInitAll(Board *board);
+static void dropInitAll(Board *board);
+static void defaultBlockLogic(Board *board);
+static void jewelsBlockLogic(Board *board);
+static void dropBlockLogic(Board *board);
 static void defaultStatusText(char *buf, int _score, int _speed);
 static void jewelsStatusText(char *buf, int _score, int _speed);
-static void defaultSetCursor();
-static void jewelsSetCursor();
-static void dropSetCursor();
-static void defaultSwitch();
-static void jewelsSwitch();
-static void dropSwitch();
-static void defaultBump();
-static void jewelsBump();
-static void dropBump();
-static void defaultPickUp();
-static void jewelsPickUp();
-static void dropPickUp();
-static void defaultGetHeld(int *color, int *amount);
-static void jewelsGetHeld(int *color, int *amount);
-static void dropGetHeld(int *color, int *amount);
+static void defaultSetCursor(Board *board);
+static void jewelsSetCursor(Board *board);
+static void dropSetCursor(Board *board);
+static void defaultSwitch(Board *board);
+static void jewelsSwitch(Board *board);
+static void dropSwitch(Board *board);
+static void defaultBump(Board *board);
+static void jewelsBump(Board *board);
+static void dropBump(Board *board);
+static void defaultPickUp(Board *board);
+static void jewelsPickUp(Board *board);
+static void dropPickUp(Board *board);
+static void defaultGetHeld(Board *board, int *color, int *amount);
+static void jewelsGetHeld(Board *board, int *color, int *amount);
+static void dropGetHeld(Board *board, int *color, int *amount);
 
-static int dropColor = -1;
-static int dropAmount = 0;
+const GameMode game_mode_default = {
+    .setDefaults = defaultSetDefaults,
+    .initAll = defaultInitAll,
+    .blockLogic = defaultBlockLogic,
+    .statusText = defaultStatusText,
+    .speed = true,
+    .moves = false,
+    .kernels = &block_kernels_13x10,
+    .setCursor = defaultSetCursor,
+    .doSwitch = defaultSwitch,
+    .bump = defaultBump,
+    .pickUp = defaultPickUp,
+    .getHeld = defaultGetHeld,
+};
 
-void gameModeInit() {
-    game_mode_default.setDefaults = defaultSetDefaults;
-    game_mode_default.drawOffsetExtraY = BLOCK_SIZE-(img_bar->h);
-    game_mode_default.initAll = defaultInitAll;
-    game_mode_default.blockLogic = defaultBlockLogic;
-    game_mode_default.background = img_background;
-    game_mode_default.statusText = defaultStatusText;
-    game_mode_default.music = music;
-    game_mode_default.speed = true;
-    game_mode_default.setCursor = defaultSetCursor;
-    game_mode_default.doSwitch = defaultSwitch;
-    game_mode_default.bump = defaultBump;
-    game_mode_default.pickUp = defaultPickUp;
-    game_mode_default.getHeld= defaultGetHeld;
-    game_mode_default.highscores = &path_file_highscores;
+const GameMode game_mode_jewels = {
+    .setDefaults = jewelsSetDefaults,
+    .initAll = jewelsInitAll,
+    .blockLogic = jewelsBlockLogic,
+    .statusText = jewelsStatusText,
+    .speed = false,
+    .moves = true,
+    .kernels = &block_kernels_8x8,
+    .setCursor = jewelsSetCursor,
+    .doSwitch = jewelsSwitch,
+    .bump = jewelsBump,
+    .pickUp = jewelsPickUp,
+    .getHeld = jewelsGetHeld,
+};
 
-    game_mode_jewels = game_mode_default;
-    game_mode_jewels.setDefaults = jewelsSetDefaults;
-    game_mode_jewels.drawOffsetExtraY = 0;
-    game_mode_jewels.initAll = jewelsInitAll;
-    game_mode_jewels.blockLogic = jewelsBlockLogic;
-    game_mode_jewels.background = img_background_jewels;
-    game_mode_jewels.statusText = jewelsStatusText;
-    game_mode_jewels.music = music_jewels;
-    game_mode_jewels.speed = false;
-    game_mode_jewels.setCursor = jewelsSetCursor;
-    game_mode_jewels.doSwitch = jewelsSwitch;
-    game_mode_jewels.bump = jewelsBump;
-    game_mode_jewels.pickUp = jewelsPickUp;
-    game_mode_jewels.getHeld = jewelsGetHeld;
-    game_mode_jewels.highscores = &path_file_highscores_jewels;
+const GameMode game_mode_drop = {
+    .setDefaults = dropSetDefaults,
+    .initAll = dropInitAll,
+    .blockLogic = dropBlockLogic,
+    .statusText = defaultStatusText,
+    .speed = true,
+    .moves = false,
+    .kernels = &block_kernels_8x9,
+    .setCursor = dropSetCursor,
+    .doSwitch = dropSwitch,
+    .bump = dropBump,
+    .pickUp = dropPickUp,
+    .getHeld = dropGetHeld,
+};
 
-    game_mode_drop = game_mode_default;
-    game_mode_drop.setDefaults = dropSetDefaults;
-    game_mode_drop.drawOffsetExtraY = BLOCK_SIZE-(img_bar->h)+(BLOCK_SIZE/2);
-    game_mode_drop.initAll = dropInitAll;
-    game_mode_drop.blockLogic = dropBlockLogic;
-    game_mode_drop.background = img_background_drop;
-    game_mode_drop.setCursor = dropSetCursor;
-    game_mode_drop.doSwitch = dropSwitch;
-    game_mode_drop.bump = dropBump;
-    game_mode_drop.pickUp = dropPickUp;
-    game_mode_drop.getHeld= dropGetHeld;
-    game_mode_drop.highscores = &path_file_highscores_drop;
-}
+// the same as the default mode on a board too big for the sized kernels
+const GameMode game_mode_marathon = {
+    .setDefaults = marathonSetDefaults,
+    .initAll = defaultInitAll,
+    .blockLogic = defaultBlockLogic,
+    .statusText = defaultStatusText,
+    .speed = true,
+    .moves = false,
+    .kernels = NULL,
+    .setCursor = defaultSetCursor,
+    .doSwitch = defaultSwitch,
+    .bump = defaultBump,
+    .pickUp = defaultPickUp,
+    .getHeld = defaultGetHeld,
+};
 
-int gameModeGetIndex() {
-    if (game_mode == &game_mode_default)
+int gameModeGetIndex(const GameMode *mode) {
+    if (mode == &game_mode_default)
         return GAME_MODE_DEFAULT;
-    else if (game_mode == &game_mode_jewels)
+    else if (mode == &game_mode_jewels)
         return GAME_MODE_JEWELS;
-    else if (game_mode == &game_mode_drop)
+    else if (mode == &game_mode_drop)
         return GAME_MODE_DROP;
+    else if (mode == &game_mode_marathon)
+        return GAME_MODE_MARATHON;
     else
         return GAME_MODE_DEFAULT;
 }
 
-static void defaultSetDefaults() {
-    ROWS = 10;
-    COLS = 13;
-    NUM_BLOCKS = 7;
-    START_ROWS = 4;
-    DISABLED_ROWS = 1;
-    CURSOR_MAX_X = COLS-2;
-    CURSOR_MIN_Y = 1;
-    BLOCK_MOVE_FRAMES = 4;
+static void defaultSetDefaults(Board *board) {
+    board->rows = 10;
+    board->cols = 13;
+    board->num_blocks = 7;
+    board->start_rows = 4;
+    board->disabled_rows = 1;
+    board->cursor_max_x = board->cols-2;
+    board->cursor_min_y = 1;
+    board->block_move_frames = 4;
+}
+static void jewelsSetDefaults(Board *board) {
+    board->rows = 8;
+    board->cols = 8;
+    board->num_blocks = 7;
+    board->start_rows = board->rows;
+    board->disabled_rows = 0;
+    board->cursor_max_x = board->cols-1;
+    board->cursor_min_y = 0;
+    board->block_move_frames = 8;
 }
-static void jewelsSetDefaults() {
-    ROWS = 8;
-    COLS = 8;
-    NUM_BLOCKS = 7;
-    START_ROWS = ROWS;
-    DISABLED_ROWS = 0;
-    CURSOR_MAX_X = COLS-1;
-    CURSOR_MIN_Y = 0;
-    BLOCK_MOVE_FRAMES = 8;
+static void dropSetDefaults(Board *board) {
+    board->rows = 9;
+    board->cols = 8;
+    board->num_blocks = 4;
+    board->start_rows = 4;
+    board->disabled_rows = 1;
+    board->cursor_max_x = board->cols-1;
+    board->cursor_min_y = 1;
+    board->block_move_frames = 4;
 }
-static void dropSetDefaults() {
-    ROWS = 9;
-    COLS = 8;
-    NUM_BLOCKS = 4;
-    START_ROWS = 4;
-    DISABLED_ROWS = 1;
-    CURSOR_MAX_X = COLS-1;
-    CURSOR_MIN_Y = 1;
-    BLOCK_MOVE_FRAMES = 4;
+static void marathonSetDefaults(Board *board) {
+    // the normal rules on a board much bigger than the screen, which
+    // scrolls to follow the cursor
+    board->rows = 256;
+    board->cols = 256;
+    board->num_blocks = 7;
+    board->start_rows = 64;
+    board->disabled_rows = 1;
+    board->cursor_max_x = board->cols-2;
+    board->cursor_min_y = 1;
+    board->block_move_frames = 4;
 }
 
-static void defaultInitAll() {
-    for(int i=ROWS-START_ROWS;i<ROWS;i++) {
-        blockAddLayerRandom(i);
+static void defaultInitAll(Board *board) {
+    for(int i=board->rows-board->start_rows;i<board->rows;i++) {
+        blockAddLayerRandom(board, i);
     }
 }
-static void jewelsInitAll() {
-    do {
-        for(int i=ROWS-START_ROWS;i<ROWS;i++) {
-            for(int j=0;j<COLS;j++) {
-                blockSet(i,j,true,blockRand());
+static void jewelsFillBoard(Board *board, int move_col) {
+    // Fill the board without any matches by never picking the color that
+    // would make a third in a row or column. If move_col isn't -1, the top
+    // row gets "X X Y X" from that column on, so swapping the last two
+    // blocks is always a match.
+    int first_row = board->rows-board->start_rows;
+    int move_color = -1;
+    for(int i=first_row;i<board->rows;i++) {
+        for(int j=0;j<board->cols;j++) {
+            int left = -1;
+            int up = -1;
+            if (j >= 2 && board->blocks[i][j-1].color == board->blocks[i][j-2].color)
+                left = board->blocks[i][j-1].color;
+            if (i >= first_row+2 && board->blocks[i-1][j].color == board->blocks[i-2][j].color)
+                up = board->blocks[i-1][j].color;
+
+            if (i == first_row && move_col != -1 && j >= move_col && j <= move_col+3 && j != move_col+2) {
+                // X can't be the block to the left, or it would make a run
+                // of 3 with the first two
+                if (j == move_col)
+                    move_color = blockRandExcept(board, j > 0 ? board->blocks[i][j-1].color : -1, -1);
+                blockSet(board, i,j,true,move_color);
+            }
+            else {
+                blockSet(board, i,j,true,blockRandExcept(board, left, up));
             }
         }
-    } while (blockHasMatches());
+    }
 }
-static void dropInitAll() {
-    for(int i=ROWS-START_ROWS;i<ROWS;i++) {
-        for(int j=0;j<COLS;j++) {
-            blockSet(i,j,true,blockRand());
+static void jewelsInitAll(Board *board) {
+    jewelsFillBoard(board, -1);
+
+    // a board without any moves would be over before it started, so fill it
+    // again with a move planted in it
+    if (!blockHasSwitchMatch(board) && board->cols >= 4)
+        jewelsFillBoard(board, blockRandRange(board, board->cols-3));
+}
+static void dropInitAll(Board *board) {
+    for(int i=board->rows-board->start_rows;i<board->rows;i++) {
+        for(int j=0;j<board->cols;j++) {
+            blockSet(board, i,j,true,blockRand(board));
         }
     }
 
-    dropColor = -1;
-    dropAmount = 0;
+    board->drop_color = -1;
+    board->drop_amount = 0;
 }
 
-static void defaultBlockLogic() {
-    blockClearMatches();
-    blockFindMatch3();
-    blockRise();
-    blockGravity();
+static void defaultBlockLogic(Board *board) {
+    blockClearMatches(board);
+    blockFindMatch3(board);
+    blockRise(board);
+    blockGravity(board);
 }
-static void jewelsBlockLogic() {
-    blockClearMatches();
-    blockFindMatch3();
-    blockReturn();
-    blockAddFromTop();
-    blockGravity();
-    if (!blockHasGaps() && !blockHasSwitchMatch())
-        game_over_timer = FPS * 2;
+static void jewelsBlockLogic(Board *board) {
+    blockClearMatches(board);
+    blockFindMatch3(board);
+    blockReturn(board);
+    blockAddFromTop(board);
+    blockGravity(board);
+    // reshuffle instead of ending the game when there are no moves left
+    if (!blockHasGaps(board) && !blockHasSwitchMatch(board))
+        jewelsInitAll(board);
 }
-static void dropBlockLogic() {
-    blockClearMatches();
-    blockRise();
-    blockGravity();
+static void dropBlockLogic(Board *board) {
+    blockClearMatches(board);
+    blockRise(board);
+    blockGravity(board);
 }
 
 static void defaultStatusText(char *buf, int _score, int _speed) {
@@ -190,129 +248,126 @@ static void jewelsStatusText(char *buf, int _score, int _speed) {
     sprintf(buf, "Score: %-10d", _score);
 }
 
-static void defaultSetCursor() {
-    cursor.x2 = cursor.x1 + 1;
-    cursor.y2 = cursor.y1;
+static void defaultSetCursor(Board *board) {
+    board->cursor.x2 = board->cursor.x1 + 1;
+    board->cursor.y2 = board->cursor.y1;
 }
-static void jewelsSetCursor() {
-    cursor.x2 = cursor.x1;
-    cursor.y2 = cursor.y1;
+static void jewelsSetCursor(Board *board) {
+    board->cursor.x2 = board->cursor.x1;
+    board->cursor.y2 = board->cursor.y1;
 }
-static void dropSetCursor() {
+static void dropSetCursor(Board *board) {
     // always set cursor to top block in column
-    for (int i=CURSOR_MAX_Y;i>=0;i--) {
-        if (!blocks[i][cursor.x1].alive) {
-            cursor.y1 = min(max(i + 1, 0), CURSOR_MAX_Y);
-            break;
-        }
-    }
-    cursor.x2 = cursor.x1;
-    cursor.y2 = cursor.y1;
+    // the disabled rows are always full, so a column is never empty
+    int top = blockColumnTop(board, board->cursor.x1);
+    if (top > 0)
+        board->cursor.y1 = min(top, board->cursor_max_y);
+    board->cursor.x2 = board->cursor.x1;
+    board->cursor.y2 = board->cursor.y1;
 }
 
-static void defaultBump() {
-    if (blockAddLayer())
-        score += POINTS_PER_BUMP;
+static void defaultBump(Board *board) {
+    if (blockAddLayer(board))
+        board->score += POINTS_PER_BUMP;
 }
-static void jewelsBump() {
-    jewels_cursor_select = false;
+static void jewelsBump(Board *board) {
+    board->jewels_cursor_select = false;
 }
-static void dropBump() {
-    if (blockAddLayer())
-        score += POINTS_PER_BUMP;
+static void dropBump(Board *board) {
+    if (blockAddLayer(board))
+        board->score += POINTS_PER_BUMP;
 }
 
-static void defaultSwitch() {
-    blockSwitchCursor();
+static void defaultSwitch(Board *board) {
+    blockSwitchCursor(board);
 }
-static void jewelsSwitch() {
-    if (!jewels_cursor_select) {
-        jewels_cursor_select = true;
-        cursor.x2 = cursor.x1;
-        cursor.y2 = cursor.y1;
+static void jewelsSwitch(Board *board) {
+    if (!board->jewels_cursor_select) {
+        board->jewels_cursor_select = true;
+        board->cursor.x2 = board->cursor.x1;
+        board->cursor.y2 = board->cursor.y1;
         return;
     }
     else {
-        jewels_cursor_select = false;
+        board->jewels_cursor_select = false;
     }
 
-    if (blockSwitchCursor()) {
-        blocks[cursor.y1][cursor.x1].return_row = cursor.y2;
-        blocks[cursor.y1][cursor.x1].return_col = cursor.x2;
-        cursor.x2 = cursor.x1;
-        cursor.y2 = cursor.y1;
+    if (blockSwitchCursor(board)) {
+        blockSetReturn(board, board->cursor.y1, board->cursor.x1, board->cursor.y2, board->cursor.x2);
+        board->cursor.x2 = board->cursor.x1;
+        board->cursor.y2 = board->cursor.y1;
     }
 }
-static void dropSwitch() {
-    if (dropAmount == 0) {
+static void dropSwitch(Board *board) {
+    if (board->drop_amount == 0) {
         return;
     }
     // Eject all the blocks held TODO: animate
+    // they land on top of the stack, however far below the cursor that is
     int i;
-    for (i = cursor.y1; i > 0 && dropAmount > 0; i--, dropAmount--) {
-        if (blocks[i][cursor.x1].alive) {
-            dropAmount++;
+    for (i = blockColumnTop(board, board->cursor.x1) - 1; i > 0 && board->drop_amount > 0; i--, board->drop_amount--) {
+        if (board->blocks[i][board->cursor.x1].alive) {
+            board->drop_amount++;
             continue;
         }
-        blocks[i][cursor.x1].color = dropColor;
-        blocks[i][cursor.x1].alive = true;
+        blockSetAlive(board, i, board->cursor.x1, true, board->drop_color);
     }
     // Check if there is a match in the current column
-    if (blockMatchVertical(i + 1, cursor.x1) > 1) {
+    if (blockMatchVertical(board, i + 1, board->cursor.x1) > 1) {
         // Perform a flooding match from the dropped blocks
-        blockMatchAdjacent(i + 1, cursor.x1);
-        Mix_PlayChannel(-1,sound_match,0);
+        if (blockMatchAdjacent(board, i + 1, board->cursor.x1) > 0)
+            coreEvent(board, CORE_EVENT_MATCH);
     }
-    if (dropAmount == 0) {
-        dropColor = -1;
+    if (board->drop_amount == 0) {
+        board->drop_color = -1;
     }
 }
 
-static void defaultPickUp() {
+static void defaultPickUp(Board *board) {
     // unused
 }
 
-static void jewelsPickUp() {
+static void jewelsPickUp(Board *board) {
     // unused
 }
 
-static void dropPickUp() {
+static void dropPickUp(Board *board) {
     // don't grab if no blocks in column
-    if (cursor.y1 == ROWS - 1 || !blocks[cursor.y1][cursor.x1].alive || blocks[cursor.y1][cursor.x1].matched) {
+    if (board->cursor.y1 == board->rows - 1 || !board->blocks[board->cursor.y1][board->cursor.x1].alive || board->blocks[board->cursor.y1][board->cursor.x1].matched) {
         return;
     }
-    int color = blocks[cursor.y1][cursor.x1].color;
+    int color = board->blocks[board->cursor.y1][board->cursor.x1].color;
     // if currently no blocks grabbed, grab any color
-    if (dropColor == -1) {
-        dropColor = color;
+    if (board->drop_color == -1) {
+        board->drop_color = color;
     }
     // only grab blocks of the same color
-    if (color != dropColor) {
+    if (color != board->drop_color) {
         return;
     }
     // Grab the blocks TODO: animate
-    for (int i = cursor.y1; i < ROWS-DISABLED_ROWS; i++) {
-        if (blocks[i][cursor.x1].color != color || blocks[i][cursor.x1].matched) {
+    for (int i = board->cursor.y1; i < board->rows-board->disabled_rows; i++) {
+        if (board->blocks[i][board->cursor.x1].color != color || board->blocks[i][board->cursor.x1].matched) {
             break;
         }
-        blocks[i][cursor.x1].alive = false;
-        dropAmount++;
+        blockSetAlive(board, i, board->cursor.x1, false, color);
+        board->drop_amount++;
     }
-    Mix_PlayChannel(-1,sound_switch,0);
+    coreEvent(board, CORE_EVENT_SWITCH);
 }
 
-static void defaultGetHeld(int *color, int *amount) {
+static void defaultGetHeld(Board *board, int *color, int *amount) {
     // unused
 }
 
-static void jewelsGetHeld(int *color, int *amount) {
+static void jewelsGetHeld(Board *board, int *color, int *amount) {
     // unused
 }
 
-static void dropGetHeld(int *color, int *amount) {
+static void dropGetHeld(Board *board, int *color, int *amount) {
     if (color)
-        *color = dropColor;
+        *color = board->drop_color;
 
     if (amount)
-        *amount = dropAmount;
+        *amount = board->drop_amount;
 }
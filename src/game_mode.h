@@ -19,40 +19,41 @@
 #ifndef GAME_MODE_H
 #define GAME_MODE_H
 
-#include <SDL.h>
-
-#include "string.h"
-#include "sys.h"
+#include "core.h"
 
 enum {
     GAME_MODE_DEFAULT,
     GAME_MODE_JEWELS,
-    GAME_MODE_DROP
+    GAME_MODE_DROP,
+    GAME_MODE_MARATHON,
+    GAME_MODE_COUNT
 };
 
+struct Board;
+struct BlockKernels;
+
+// The rules of a mode. The tables are shared by every Board and never
+// change, so how the game shows a mode is kept apart from them, in game.h.
 typedef struct GameMode{
-    void (*setDefaults)(void);
-    int drawOffsetExtraY;
-    void (*initAll)(void);
-    void (*blockLogic)(void);
-    Image *background;
+    void (*setDefaults)(struct Board *board);
+    void (*initAll)(struct Board *board);
+    void (*blockLogic)(struct Board *board);
     void (*statusText)(char *buf, int _score, int _speed);
-    Mix_Music *music;
     bool speed;
-    void (*setCursor)(void);
-    void (*doSwitch)(void);
-    void (*bump)(void);
-    void (*pickUp)(void);
-    void (*getHeld)(int *color, int *amount);
-    String *highscores;
+    bool moves;
+    const struct BlockKernels *kernels;
+    void (*setCursor)(struct Board *board);
+    void (*doSwitch)(struct Board *board);
+    void (*bump)(struct Board *board);
+    void (*pickUp)(struct Board *board);
+    void (*getHeld)(struct Board *board, int *color, int *amount);
 }GameMode;
 
-GameMode *game_mode;
-GameMode game_mode_default;
-GameMode game_mode_jewels;
-GameMode game_mode_drop;
+extern const GameMode game_mode_default;
+extern const GameMode game_mode_jewels;
+extern const GameMode game_mode_drop;
+extern const GameMode game_mode_marathon;
 
-void gameModeInit();
-int gameModeGetIndex();
+int gameModeGetIndex(const GameMode *mode);
 
 #endif
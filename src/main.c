@@ -22,10 +22,12 @@
 
 #include "block.h"
 #include "draw.h"
+#include "ease.h"
 #include "game.h"
 #include "game_mode.h"
 #include "menu.h"
 #include "sys.h"
+#include "workers.h"
 
 #ifdef __EMSCRIPTEN__
 #include "emscripten.h"
@@ -49,7 +51,10 @@ int main(int argc, char *argv[]) {
     if(!sysInit()) return 1;
     if(!sysLoadFiles()) return 1;
 
-    gameModeInit();
+    easeInit();
+    gameInitModes();
+    coreSetEventHandler(gamePlaySound);
+    workersInit(0);
     menuInit();
     gameTitle();
 
@@ -73,6 +78,7 @@ int main(int argc, char *argv[]) {
         if(deltaTimer < (1000/FPS))
             SDL_Delay((1000/FPS)-deltaTimer);
     }
-    blockCleanup();
+    blockCleanup(&game_board);
+    workersCleanup();
     sysCleanup();
 }
@@ -0,0 +1,258 @@
+/*
+    FreeBlocks -  A simple puzzle game, similar to Tetris Attack
+    Copyright (C) 2012-2017 Justin Jacobs
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+
+#include "block.h"
+#include "moves.h"
+
+static int movesIndex(const Board *board, int i, int j) {
+    // entries are kept by physical row, so they stay put when rows rotate
+    int r = i + board->row_base;
+    if (r >= board->rows) r -= board->rows;
+    return r*board->cols + j;
+}
+
+static int movesContent(const Board *board, int i, int j) {
+    // the color a block could match with, or -1
+    if (!board->blocks[i][j].alive || board->blocks[i][j].color == -1) return -1;
+    return board->blocks[i][j].color;
+}
+
+static bool movesSlotOk(const Board *board, int i, int j) {
+    // blocks that are still being cleared can't match, whatever is in them
+    return board->blocks[i][j].clear_timer == 0 && board->blocks[i][j].frame <= 0;
+}
+
+static int movesKey(const Board *board, int i, int j) {
+    const Moves* moves = &board->moves;
+    if (!movesSlotOk(board, i, j)) return -1;
+    if (i == moves->swap_i && j == moves->swap_j) return movesContent(board, moves->swap_k, moves->swap_l);
+    if (i == moves->swap_k && j == moves->swap_l) return movesContent(board, moves->swap_i, moves->swap_j);
+    return movesContent(board, i, j);
+}
+
+static bool movesRunThrough(const Board *board, int i, int j) {
+    // same rules as blockHasMatches(): horizontal runs anywhere, vertical
+    // runs only above the disabled rows
+    int key = movesKey(board, i, j);
+    if (key == -1) return false;
+
+    int count = 1;
+    for (int l=j-1; l>=0 && movesKey(board, i, l) == key; l--) count++;
+    for (int l=j+1; l<board->cols && movesKey(board, i, l) == key; l++) count++;
+    if (count >= 3) return true;
+
+    int last_row = board->rows-board->disabled_rows;
+    if (i >= last_row) return false;
+
+    count = 1;
+    for (int k=i-1; k>=0 && movesKey(board, k, j) == key; k--) count++;
+    for (int k=i+1; k<last_row && movesKey(board, k, j) == key; k++) count++;
+    return count >= 3;
+}
+
+static bool movesEvaluate(Board *board, int i, int j, int k, int l) {
+    // blockSwitch() refuses to move matched blocks
+    if (board->blocks[i][j].matched || board->blocks[k][l].matched) return false;
+
+    Moves* moves = &board->moves;
+    moves->swap_i = i; moves->swap_j = j; moves->swap_k = k; moves->swap_l = l;
+    bool legal = movesRunThrough(board, i, j) || movesRunThrough(board, k, l);
+    moves->swap_i = moves->swap_j = moves->swap_k = moves->swap_l = -1;
+
+    return legal;
+}
+
+static void movesRefreshRun(Board *board, int i, int j) {
+    // whether (i,j) is in a match as the board stands
+    if (i < 0 || j < 0 || i >= board->rows || j >= board->cols) return;
+
+    MoveCell* cell = &board->moves.cells[movesIndex(board, i, j)];
+    bool in_run = movesRunThrough(board, i, j);
+    if (in_run != cell->in_run) {
+        cell->in_run = in_run;
+        board->moves.run_count += in_run ? 1 : -1;
+    }
+}
+
+static void movesRefresh(Board *board, int i, int j, unsigned char move) {
+    if (i < 0 || j < 0 || i >= board->rows || j >= board->cols) return;
+
+    bool legal = false;
+    if (move == MOVE_RIGHT && j+1 < board->cols)
+        legal = movesEvaluate(board, i, j, i, j+1);
+    else if (move == MOVE_DOWN && i+1 < board->rows)
+        legal = movesEvaluate(board, i, j, i+1, j);
+
+    unsigned char* bits = &board->moves.legal[movesIndex(board, i, j)];
+    if (legal && !(*bits & move)) {
+        *bits |= move;
+        board->moves.count++;
+    }
+    else if (!legal && (*bits & move)) {
+        *bits &= ~move;
+        board->moves.count--;
+    }
+}
+
+void movesInit(Board *board) {
+    movesCleanup(board);
+
+    Moves* moves = &board->moves;
+    int cells = board->rows*board->cols;
+    moves->legal = calloc(cells, sizeof(unsigned char));
+    moves->cells = malloc(sizeof(MoveCell)*cells);
+    moves->count = 0;
+    moves->run_count = 0;
+    moves->swap_i = moves->swap_j = moves->swap_k = moves->swap_l = -1;
+
+    for (int n=0; n<cells; n++) {
+        moves->cells[n].key = -2;
+        moves->cells[n].slot_ok = false;
+        moves->cells[n].matched = false;
+        moves->cells[n].in_run = false;
+    }
+}
+
+void movesCleanup(Board *board) {
+    free(board->moves.legal);
+    board->moves.legal = NULL;
+    free(board->moves.cells);
+    board->moves.cells = NULL;
+    board->moves.count = 0;
+    board->moves.run_count = 0;
+}
+
+bool movesEnabled(const Board *board) {
+    return board->moves.legal != NULL;
+}
+
+void movesUpdateCell(Board *board, int i, int j) {
+    if (!board->moves.legal) return;
+
+    MoveCell* cell = &board->moves.cells[movesIndex(board, i, j)];
+    int key = movesContent(board, i, j);
+    bool slot_ok = movesSlotOk(board, i, j);
+    if (cell->key == key && cell->slot_ok == slot_ok && cell->matched == board->blocks[i][j].matched)
+        return;
+
+    cell->key = key;
+    cell->slot_ok = slot_ok;
+    cell->matched = board->blocks[i][j].matched;
+
+    // A swap looks at most 2 blocks past either of its cells, so only the
+    // swaps anchored near this cell can have changed
+    for (int a=i-2; a<=i+2; a++) {
+        movesRefresh(board, a, j-1, MOVE_RIGHT);
+        movesRefresh(board, a, j, MOVE_RIGHT);
+    }
+    for (int b=j-3; b<=j+2; b++) {
+        if (b != j-1 && b != j)
+            movesRefresh(board, i, b, MOVE_RIGHT);
+    }
+
+    for (int b=j-2; b<=j+2; b++) {
+        movesRefresh(board, i-1, b, MOVE_DOWN);
+        movesRefresh(board, i, b, MOVE_DOWN);
+    }
+    for (int a=i-3; a<=i+2; a++) {
+        if (a != i-1 && a != i)
+            movesRefresh(board, a, j, MOVE_DOWN);
+    }
+
+    // and a match through a block only reaches 2 past it
+    for (int d=-2; d<=2; d++) {
+        movesRefreshRun(board, i, j+d);
+        if (d != 0)
+            movesRefreshRun(board, i+d, j);
+    }
+}
+
+void movesRebuild(Board *board) {
+    // re-evaluate everything, for when the whole board has moved
+    if (!board->moves.legal) return;
+
+    for (int n=0; n<board->rows*board->cols; n++) {
+        board->moves.legal[n] = 0;
+        board->moves.cells[n].key = -2;
+        board->moves.cells[n].in_run = false;
+    }
+    board->moves.count = 0;
+    board->moves.run_count = 0;
+
+    for (int i=0; i<board->rows; i++) {
+        for (int j=0; j<board->cols; j++) {
+            movesUpdateCell(board, i, j);
+        }
+    }
+}
+
+static void movesRefreshRows(Board *board, int first, int last) {
+    for (int i=max(first, 0); i<=last && i<board->rows; i++) {
+        for (int j=0; j<board->cols; j++) {
+            movesRefresh(board, i, j, MOVE_RIGHT);
+            movesRefresh(board, i, j, MOVE_DOWN);
+            movesRefreshRun(board, i, j);
+        }
+    }
+}
+
+void movesRotate(Board *board) {
+    // Called after every row has moved up by one, with the old top row now
+    // at the bottom. A swap only looks 2 blocks past its cells, so it still
+    // sees the same blocks unless that reaches across the wrap or across the
+    // edge of the disabled rows.
+    if (!board->moves.legal) return;
+
+    int last_row = board->rows-board->disabled_rows;
+    movesRefreshRows(board, 0, 2);
+    movesRefreshRows(board, last_row-4, last_row+1);
+    movesRefreshRows(board, board->rows-4, board->rows-1);
+}
+
+int movesCount(const Board *board) {
+    return board->moves.count;
+}
+
+int movesRunCount(const Board *board) {
+    return board->moves.run_count;
+}
+
+bool movesGet(const Board *board, int n, int *row, int *col, int *dir) {
+    // The nth legal swap, counting from the top left, as the cell it's
+    // anchored on and MOVE_RIGHT or MOVE_DOWN. False once n reaches
+    // movesCount().
+    if (!board->moves.legal || n < 0 || n >= board->moves.count) return false;
+
+    for (int i=0; i<board->rows; i++) {
+        for (int j=0; j<board->cols; j++) {
+            unsigned char bits = board->moves.legal[movesIndex(board, i, j)];
+            for (int move=MOVE_RIGHT; move<=MOVE_DOWN; move++) {
+                if (!(bits & move)) continue;
+                if (n-- == 0) {
+                    *row = i;
+                    *col = j;
+                    *dir = move;
+                    return true;
+                }
+            }
+        }
+    }
+    return false;
+}
@@ -0,0 +1,60 @@
+/*
+    FreeBlocks -  A simple puzzle game, similar to Tetris Attack
+    Copyright (C) 2012-2017 Justin Jacobs
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MOVES_H
+#define MOVES_H
+
+#include <stdbool.h>
+
+// Index of every neighbouring swap that would create a match. Each cell
+// anchors two swaps: with the block to its right and with the one below.
+// It also counts the blocks already in a match, so neither question needs
+// a scan of the board.
+#define MOVE_RIGHT 1
+#define MOVE_DOWN 2
+
+typedef struct MoveCell{
+    int key;
+    bool slot_ok;
+    bool matched;
+    bool in_run;
+}MoveCell;
+
+typedef struct Moves{
+    unsigned char *legal;
+    MoveCell *cells;
+    int count;
+    int run_count;
+
+    // While evaluating a swap, these two cells have their contents exchanged
+    int swap_i, swap_j, swap_k, swap_l;
+}Moves;
+
+struct Board;
+
+void movesInit(struct Board *board);
+void movesCleanup(struct Board *board);
+bool movesEnabled(const struct Board *board);
+void movesUpdateCell(struct Board *board, int i, int j);
+void movesRebuild(struct Board *board);
+void movesRotate(struct Board *board);
+int movesCount(const struct Board *board);
+int movesRunCount(const struct Board *board);
+bool movesGet(const struct Board *board, int n, int *row, int *col, int *dir);
+
+#endif
@@ -0,0 +1,152 @@
+/*
+    FreeBlocks -  A simple puzzle game, similar to Tetris Attack
+    Copyright (C) 2012-2017 Justin Jacobs
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "plane.h"
+
+#if defined(PLANE_SSE2) || defined(PLANE_NEON)
+
+#ifdef PLANE_SSE2
+#include <emmintrin.h>
+#else
+#include <arm_neon.h>
+#endif
+
+// Cells compared at once
+#define PLANE_LANES 16
+
+static unsigned char* planeRow(const Plane *plane, int i) {
+    int r = i + plane->base;
+    if (r >= plane->rows) r -= plane->rows;
+    return plane->cells + r*plane->stride;
+}
+
+static unsigned planeEqual3(const unsigned char* a, const unsigned char* b, const unsigned char* c) {
+    // bit n is set where a[n], b[n] and c[n] are all the same color
+#ifdef PLANE_SSE2
+    __m128i va = _mm_loadu_si128((const __m128i*)a);
+    __m128i vb = _mm_loadu_si128((const __m128i*)b);
+    __m128i vc = _mm_loadu_si128((const __m128i*)c);
+    __m128i eq = _mm_and_si128(_mm_cmpeq_epi8(va, vb), _mm_cmpeq_epi8(vb, vc));
+    __m128i none = _mm_cmpeq_epi8(va, _mm_set1_epi8((char)PLANE_NONE));
+    return (unsigned)_mm_movemask_epi8(_mm_andnot_si128(none, eq));
+#else
+    static const unsigned char weights[PLANE_LANES] = {1,2,4,8,16,32,64,128, 1,2,4,8,16,32,64,128};
+    uint8x16_t va = vld1q_u8(a);
+    uint8x16_t vb = vld1q_u8(b);
+    uint8x16_t vc = vld1q_u8(c);
+    uint8x16_t eq = vandq_u8(vceqq_u8(va, vb), vceqq_u8(vb, vc));
+    eq = vbicq_u8(eq, vceqq_u8(va, vdupq_n_u8(PLANE_NONE)));
+    uint8x16_t bits = vandq_u8(eq, vld1q_u8(weights));
+    return vaddv_u8(vget_low_u8(bits)) | ((unsigned)vaddv_u8(vget_high_u8(bits)) << 8);
+#endif
+}
+
+static void planeAddMask(BitWord* out, int j, unsigned mask) {
+    out[j / BITBOARD_WORD_BITS] |= (BitWord)mask << (j % BITBOARD_WORD_BITS);
+}
+
+void planeInit(Plane *plane, const Bitboard *bitboard, int rows, int cols) {
+    planeCleanup(plane);
+
+    plane->rows = rows;
+    plane->cols = cols;
+    plane->words = (cols + BITBOARD_WORD_BITS - 1) / BITBOARD_WORD_BITS;
+    plane->stride = (cols + PLANE_LANES - 1) / PLANE_LANES * PLANE_LANES + PLANE_LANES;
+    plane->base = 0;
+    plane->bitboard = bitboard;
+
+    plane->cells = malloc(plane->rows * plane->stride);
+    memset(plane->cells, PLANE_NONE, plane->rows * plane->stride);
+}
+
+void planeCleanup(Plane *plane) {
+    free(plane->cells);
+    plane->cells = NULL;
+}
+
+void planeRotate(Plane *plane) {
+    // row 0 becomes the last row, and every other row moves up by one
+    plane->base = (plane->base + 1) % plane->rows;
+}
+
+void planeSetCell(Plane *plane, int i, int j, int color) {
+    // color is -1 for a cell that can't match
+    if (color < 0 || color >= BITBOARD_MAX_COLORS) color = PLANE_NONE;
+    planeRow(plane, i)[j] = (unsigned char)color;
+}
+
+bool planeMatchRow(const Plane *plane, int i, int v_begin, int v_end, BitWord* out) {
+    // Same as bitboardMatchRow(): cells in row i that belong to a horizontal
+    // run of 3 or more, or to a vertical run of 3 or more that lies entirely
+    // within [v_begin, v_end)
+    BitWord starts[BITBOARD_MAX_WORDS] = {0};
+    const unsigned char* row = planeRow(plane, i);
+    int cols = plane->cols;
+    int words = plane->words;
+
+    memset(out, 0, sizeof(BitWord)*words);
+
+    // horizontal: a cell the same as the next two starts a run, which also
+    // covers those two
+    for (int j=0; j<cols; j+=PLANE_LANES)
+        planeAddMask(starts, j, planeEqual3(row+j, row+j+1, row+j+2));
+    for (int w=0; w<words; w++) {
+        out[w] = starts[w] | starts[w] << 1 | starts[w] << 2;
+        if (w > 0)
+            out[w] |= starts[w-1] >> (BITBOARD_WORD_BITS - 1) | starts[w-1] >> (BITBOARD_WORD_BITS - 2);
+    }
+
+    // vertical: a run starting at row s covers s..s+2, so check s = i-2..i
+    for (int s=i-2; s<=i; s++) {
+        if (s < v_begin || s+2 >= v_end)
+            continue;
+        const unsigned char* r0 = planeRow(plane, s);
+        const unsigned char* r1 = planeRow(plane, s+1);
+        const unsigned char* r2 = planeRow(plane, s+2);
+        for (int j=0; j<cols; j+=PLANE_LANES)
+            planeAddMask(out, j, planeEqual3(r0+j, r1+j, r2+j));
+    }
+
+    for (int w=0; w<words; w++)
+        if (out[w]) return true;
+    return false;
+}
+
+#else
+
+void planeInit(Plane *plane, const Bitboard *bitboard, int rows, int cols) {
+    plane->bitboard = bitboard;
+}
+
+void planeCleanup(Plane *plane) {
+}
+
+void planeRotate(Plane *plane) {
+}
+
+void planeSetCell(Plane *plane, int i, int j, int color) {
+}
+
+bool planeMatchRow(const Plane *plane, int i, int v_begin, int v_end, BitWord* out) {
+    return bitboardMatchRow(plane->bitboard, i, v_begin, v_end, out);
+}
+
+#endif
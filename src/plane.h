@@ -0,0 +1,62 @@
+/*
+    FreeBlocks -  A simple puzzle game, similar to Tetris Attack
+    Copyright (C) 2012-2017 Justin Jacobs
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PLANE_H
+#define PLANE_H
+
+#include <stdbool.h>
+
+#include "bitboard.h"
+
+// One byte per cell holding the color of each block that can match, and
+// PLANE_NONE everywhere else, so a whole row can be compared 16 cells at a
+// time with SSE2 or NEON. Without either, planeMatchRow() uses the bitboard
+// and the plane isn't kept at all.
+#if !defined(NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define PLANE_SSE2
+#elif !defined(NO_SIMD) && defined(__ARM_NEON) && defined(__aarch64__)
+#define PLANE_NEON
+#endif
+
+#define PLANE_NONE 0xFF
+
+typedef struct Plane{
+    int rows;
+    int cols;
+    int words;
+
+    // Every row has room past its last column for a full load starting 2
+    // cells before the end, and that room is always PLANE_NONE
+    int stride;
+
+    // Rows are stored as a ring, and row 0 is physical row base, the same as
+    // the bitboard
+    int base;
+    unsigned char *cells;
+
+    // what planeMatchRow() reads instead when there's no plane
+    const Bitboard *bitboard;
+}Plane;
+
+void planeInit(Plane *plane, const Bitboard *bitboard, int rows, int cols);
+void planeCleanup(Plane *plane);
+void planeRotate(Plane *plane);
+void planeSetCell(Plane *plane, int i, int j, int color);
+bool planeMatchRow(const Plane *plane, int i, int v_begin, int v_end, BitWord* out);
+
+#endif
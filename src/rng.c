@@ -0,0 +1,42 @@
+/*
+    FreeBlocks -  A simple puzzle game, similar to Tetris Attack
+    Copyright (C) 2012-2017 Justin Jacobs
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "rng.h"
+
+void rngSeed(Rng* rng, uint64_t seed) {
+    rng->state = 0;
+    rng->inc = (seed << 1) | 1;
+    rngNext(rng);
+    rng->state += seed;
+    rngNext(rng);
+}
+
+uint32_t rngNext(Rng* rng) {
+    uint64_t old = rng->state;
+    rng->state = old * 6364136223846793005ULL + rng->inc;
+
+    uint32_t xorshifted = (uint32_t)(((old >> 18) ^ old) >> 27);
+    uint32_t rot = (uint32_t)(old >> 59);
+    return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+}
+
+int rngRange(Rng* rng, int n) {
+    // a number in [0, n), scaled with a multiply instead of retried, so it
+    // always takes one draw
+    return (int)(((uint64_t)rngNext(rng) * (uint32_t)n) >> 32);
+}
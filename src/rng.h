@@ -0,0 +1,35 @@
+/*
+    FreeBlocks -  A simple puzzle game, similar to Tetris Attack
+    Copyright (C) 2012-2017 Justin Jacobs
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+
+// PCG32 generator. Each game owns one, so a game can be replayed exactly
+// from its seed without depending on the C library's rand().
+typedef struct Rng{
+    uint64_t state;
+    uint64_t inc;
+}Rng;
+
+void rngSeed(Rng* rng, uint64_t seed);
+uint32_t rngNext(Rng* rng);
+int rngRange(Rng* rng, int n);
+
+#endif
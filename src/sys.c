@@ -27,11 +27,94 @@
 #include <SDL_image.h>
 #include <SDL_ttf.h>
 
-#include "sys.h"
+#include "game.h"
 #include "game_mode.h"
+#include "sys.h"
+
+SDL_Window* window;
+SDL_Renderer* renderer;
+TTF_Font* font;
+
+int high_scores[10];
+bool title_screen;
+bool high_scores_screen;
+int options_screen;
+bool game_over;
+bool paused;
+bool force_pause;
+bool quit;
+
+int action_cooldown;
+ActionMove action_move;
+ActionMove action_last_move;
+bool action_switch;
+bool action_bump;
+bool action_pickup;
+bool action_accept;
+bool action_pause;
+bool action_exit;
+bool action_click;
+bool action_right_click;
+
+String path_dir_config;
+String path_file_config;
+String path_file_highscores;
+String path_file_highscores_jewels;
+String path_file_highscores_drop;
+String path_file_highscores_marathon;
+
+int option_joystick;
+int option_sound;
+int option_music;
+int option_fullscreen;
+
+SDL_Keycode option_key[KEY_COUNT];
+int option_joy_button[KEY_COUNT-4];
+int option_joy_axis_x;
+int option_joy_axis_y;
+
+SDL_Keycode last_key;
+int last_joy_button;
+
+SDL_Event event;
+int mouse_x;
+int mouse_y;
+bool mouse_moving;
+
+// Timers
+unsigned int startTimer;
+unsigned int endTimer;
+unsigned int deltaTimer;
+
+// Images
+Image* img_blocks;
+Image* img_clear;
+Image* img_cursor;
+Image* img_cursor_highlight;
+Image* img_bar;
+Image* img_bar_inactive;
+Image* img_bar_left;
+Image* img_bar_right;
+Image* img_background;
+Image* img_background_jewels;
+Image* img_background_drop;
+Image* img_title;
+Image* img_highscores;
+
+// Music and Sounds
+Mix_Music* music;
+Mix_Music* music_jewels;
+Mix_Chunk* sound_menu;
+Mix_Chunk* sound_switch;
+Mix_Chunk* sound_match;
+Mix_Chunk* sound_drop;
+
+// Joystick
+SDL_Joystick* joy;
 
 #ifdef __EMSCRIPTEN__
 #include <emscripten.h>
+bool emscripten_can_write;
 bool emscripten_fs_ready = false;
 
 void emscriptenFSInit() {
@@ -53,7 +136,7 @@ void emscriptenFSInit() {
 void emscriptenLoadConfigs() {
     sysConfigLoad();
 
-    GameMode *game_mode_current = game_mode;
+    const GameMode *game_mode_current = game_mode;
 
     game_mode = &game_mode_default;
     sysHighScoresLoad();
@@ -61,6 +144,8 @@ void emscriptenLoadConfigs() {
     sysHighScoresLoad();
     game_mode = &game_mode_drop;
     sysHighScoresLoad();
+    game_mode = &game_mode_marathon;
+    sysHighScoresLoad();
 
     game_mode = game_mode_current;
 }
@@ -150,7 +235,7 @@ void sysInitVars() {
     sound_drop = NULL;
     joy = NULL;
 
-    score = 0;
+    game_board.score = 0;
     title_screen = true;
     high_scores_screen = false;
     options_screen = -1;
@@ -421,6 +506,7 @@ void sysCleanup() {
     String_Clear(&path_file_config);
     String_Clear(&path_file_highscores);
     String_Clear(&path_file_highscores_jewels);
+    String_Clear(&path_file_highscores_marathon);
 
     Mix_HaltMusic();
 
@@ -630,6 +716,7 @@ void sysConfigSetPaths() {
     String_Init(&path_file_highscores, path_dir_config.buf, "/highscores", 0);
     String_Init(&path_file_highscores_jewels, path_dir_config.buf, "/highscores_jewels", 0);
     String_Init(&path_file_highscores_drop, path_dir_config.buf, "/highscores_drop", 0);
+    String_Init(&path_file_highscores_marathon, path_dir_config.buf, "/highscores_marathon", 0);
 }
 
 void sysConfigLoad() {
@@ -792,7 +879,7 @@ void sysHighScoresLoad() {
 
     mkdir(path_dir_config.buf, MKDIR_MODE);
 
-    file = fopen(game_mode->highscores->buf,"r+");
+    file = fopen(gameModeMedia(game_mode)->highscores->buf,"r+");
 
     if (file) {
         while (fgets(buffer,BUFSIZ,file)) {
@@ -817,7 +904,7 @@ void sysHighScoresSave() {
 
     mkdir(path_dir_config.buf, MKDIR_MODE);
 
-    file = fopen(game_mode->highscores->buf,"w+");
+    file = fopen(gameModeMedia(game_mode)->highscores->buf,"w+");
 
     if (file) {
         for (i=0;i<10;i++) {
@@ -826,7 +913,7 @@ void sysHighScoresSave() {
         fclose(file);
 
 #ifdef __EMSCRIPTEN__
-        emscriptenWriteFile(game_mode->highscores->buf);
+        emscriptenWriteFile(gameModeMedia(game_mode)->highscores->buf);
 #endif
     } else printf("Error: Couldn't save high scores.\n");
 }
@@ -26,12 +26,13 @@
 
 #ifdef __EMSCRIPTEN__
 #include <SDL/SDL_mixer.h>
-bool emscripten_can_write;
+extern bool emscripten_can_write;
 bool emscriptenPersistData();
 #else
 #include <SDL_mixer.h>
 #endif
 
+#include "core.h"
 #include "string.h"
 
 #ifdef __GCW0__
@@ -53,7 +54,6 @@ bool emscriptenPersistData();
 #define FONT_SIZE 24
 #endif
 
-#define FPS 60
 #define JOY_DEADZONE 8192
 #define ACTION_COOLDOWN 10 / (60/FPS)
 
@@ -83,13 +83,6 @@ bool emscriptenPersistData();
 #define stat _stat
 #endif
 
-#ifndef min
-#define min(a, b) (((a)<(b))?(a):(b))
-#endif
-#ifndef max
-#define max(a,b) (((a)>(b))?(a):(b))
-#endif
-
 #define KEY_COUNT 10
 
 enum KEYBINDS {
@@ -113,70 +106,63 @@ typedef struct Image {
     int h;
 }Image;
 
-SDL_Window* window;
-SDL_Renderer* renderer;
-TTF_Font* font;
-
-int score;
-int high_scores[10];
-bool title_screen;
-bool high_scores_screen;
-int options_screen;
-bool game_over;
-bool paused;
-bool force_pause;
-bool quit;
-
-struct Cursor {
-    int x1;
-    int y1;
-    int x2;
-    int y2;
-}cursor;
-
-int action_cooldown;
+extern SDL_Window* window;
+extern SDL_Renderer* renderer;
+extern TTF_Font* font;
+
+extern int high_scores[10];
+extern bool title_screen;
+extern bool high_scores_screen;
+extern int options_screen;
+extern bool game_over;
+extern bool paused;
+extern bool force_pause;
+extern bool quit;
+
+extern int action_cooldown;
 typedef enum {
     ACTION_NONE, ACTION_LEFT, ACTION_RIGHT, ACTION_UP, ACTION_DOWN
 }ActionMove;
-ActionMove action_move;
-ActionMove action_last_move;
-bool action_switch;
-bool action_bump;
-bool action_pickup;
-bool action_accept;
-bool action_pause;
-bool action_exit;
-bool action_click;
-bool action_right_click;
-
-String path_dir_config;
-String path_file_config;
-String path_file_highscores;
-String path_file_highscores_jewels;
-String path_file_highscores_drop;
-
-int option_joystick;
-int option_sound;
-int option_music;
-int option_fullscreen;
-
-SDL_Keycode option_key[KEY_COUNT];
-int option_joy_button[KEY_COUNT-4]; // joysticks can't remap directions
-int option_joy_axis_x;
-int option_joy_axis_y;
-
-SDL_Keycode last_key;
-int last_joy_button;
-
-SDL_Event event;
-int mouse_x;
-int mouse_y;
-bool mouse_moving;
+extern ActionMove action_move;
+extern ActionMove action_last_move;
+extern bool action_switch;
+extern bool action_bump;
+extern bool action_pickup;
+extern bool action_accept;
+extern bool action_pause;
+extern bool action_exit;
+extern bool action_click;
+extern bool action_right_click;
+
+extern String path_dir_config;
+extern String path_file_config;
+extern String path_file_highscores;
+extern String path_file_highscores_jewels;
+extern String path_file_highscores_drop;
+extern String path_file_highscores_marathon;
+
+extern int option_joystick;
+extern int option_sound;
+extern int option_music;
+extern int option_fullscreen;
+
+extern SDL_Keycode option_key[KEY_COUNT];
+extern int option_joy_button[KEY_COUNT-4]; // joysticks can't remap directions
+extern int option_joy_axis_x;
+extern int option_joy_axis_y;
+
+extern SDL_Keycode last_key;
+extern int last_joy_button;
+
+extern SDL_Event event;
+extern int mouse_x;
+extern int mouse_y;
+extern bool mouse_moving;
 
 // Timers
-unsigned int startTimer;
-unsigned int endTimer;
-unsigned int deltaTimer;
+extern unsigned int startTimer;
+extern unsigned int endTimer;
+extern unsigned int deltaTimer;
 
 // Functions
 void sysInitVars();
@@ -203,29 +189,29 @@ void logInfo(const char* format, ...);
 void logError(const char* format, ...);
 
 // Images
-Image* img_blocks;
-Image* img_clear;
-Image* img_cursor;
-Image* img_cursor_highlight;
-Image* img_bar;
-Image* img_bar_inactive;
-Image* img_bar_left;
-Image* img_bar_right;
-Image* img_background;
-Image* img_background_jewels;
-Image* img_background_drop;
-Image* img_title;
-Image* img_highscores;
+extern Image* img_blocks;
+extern Image* img_clear;
+extern Image* img_cursor;
+extern Image* img_cursor_highlight;
+extern Image* img_bar;
+extern Image* img_bar_inactive;
+extern Image* img_bar_left;
+extern Image* img_bar_right;
+extern Image* img_background;
+extern Image* img_background_jewels;
+extern Image* img_background_drop;
+extern Image* img_title;
+extern Image* img_highscores;
 
 // Music and Sounds
-Mix_Music* music;
-Mix_Music* music_jewels;
-Mix_Chunk* sound_menu;
-Mix_Chunk* sound_switch;
-Mix_Chunk* sound_match;
-Mix_Chunk* sound_drop;
+extern Mix_Music* music;
+extern Mix_Music* music_jewels;
+extern Mix_Chunk* sound_menu;
+extern Mix_Chunk* sound_switch;
+extern Mix_Chunk* sound_match;
+extern Mix_Chunk* sound_drop;
 
 // Joystick
-SDL_Joystick* joy;
+extern SDL_Joystick* joy;
 
 #endif
@@ -0,0 +1,173 @@
+/*
+    FreeBlocks -  A simple puzzle game, similar to Tetris Attack
+    Copyright (C) 2012-2017 Justin Jacobs
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+
+#include "workers.h"
+
+#ifdef USE_THREADS
+#include <pthread.h>
+#include <unistd.h>
+
+static pthread_t worker_threads[WORKERS_MAX];
+static unsigned worker_first_job[WORKERS_MAX];
+static int worker_count = 0;
+
+static pthread_mutex_t worker_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t worker_start = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t worker_done = PTHREAD_COND_INITIALIZER;
+
+// Held while a job runs. There's only one pool, so a board on another
+// thread that finds it busy runs its own loop instead of waiting.
+static pthread_mutex_t worker_run_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// The job being run. Each new job bumps job_id, which is how the workers
+// know to wake up, and band n of job_bands goes to thread n.
+static unsigned job_id = 0;
+static int job_bands = 0;
+static int job_count = 0;
+static int job_pending = 0;
+static WorkerFunc job_func = NULL;
+static void* job_data = NULL;
+static bool job_quit = false;
+
+static void workersBand(int band, int bands, int count, int* first, int* last) {
+    *first = (int)((long long)count * band / bands);
+    *last = (int)((long long)count * (band+1) / bands);
+}
+
+static void* workersMain(void* arg) {
+    int band = (int)(size_t)arg;
+    unsigned seen = worker_first_job[band];
+
+    pthread_mutex_lock(&worker_lock);
+    while (true) {
+        while (job_id == seen && !job_quit)
+            pthread_cond_wait(&worker_start, &worker_lock);
+        if (job_quit) break;
+        seen = job_id;
+
+        // not every thread gets a band when the loop is short
+        if (band >= job_bands) continue;
+
+        WorkerFunc func = job_func;
+        void* data = job_data;
+        int first, last;
+        workersBand(band, job_bands, job_count, &first, &last);
+        pthread_mutex_unlock(&worker_lock);
+
+        func(first, last, data);
+
+        pthread_mutex_lock(&worker_lock);
+        if (--job_pending == 0)
+            pthread_cond_signal(&worker_done);
+    }
+    pthread_mutex_unlock(&worker_lock);
+    return NULL;
+}
+
+void workersInit(int count) {
+    // count is how many threads share the work, including the calling one.
+    // 0 picks one per processor.
+    if (count <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        count = cpus > 0 ? (int)cpus : 1;
+    }
+    if (count > WORKERS_MAX) count = WORKERS_MAX;
+    if (count == workersCount()) return;
+
+    workersCleanup();
+
+    // band 0 is always done by the calling thread
+    for (int n=1; n<count; n++) {
+        // a new thread only picks up jobs that start after it was made
+        worker_first_job[n] = job_id;
+        if (pthread_create(&worker_threads[n], NULL, workersMain, (void*)(size_t)n) != 0)
+            break;
+        worker_count = n;
+    }
+}
+
+void workersCleanup() {
+    if (worker_count == 0) return;
+
+    pthread_mutex_lock(&worker_lock);
+    job_quit = true;
+    pthread_cond_broadcast(&worker_start);
+    pthread_mutex_unlock(&worker_lock);
+
+    for (int n=1; n<=worker_count; n++)
+        pthread_join(worker_threads[n], NULL);
+
+    worker_count = 0;
+    job_quit = false;
+}
+
+int workersCount() {
+    return worker_count + 1;
+}
+
+void workersRun(int count, int min_band, WorkerFunc func, void* data) {
+    // Call func on bands of [0, count), each at least min_band long, and
+    // wait for all of them to finish
+    int bands = min_band > 0 ? count / min_band : count;
+    if (bands > workersCount()) bands = workersCount();
+
+    if (bands <= 1 || pthread_mutex_trylock(&worker_run_lock) != 0) {
+        func(0, count, data);
+        return;
+    }
+
+    pthread_mutex_lock(&worker_lock);
+    job_bands = bands;
+    job_count = count;
+    job_pending = bands-1;
+    job_func = func;
+    job_data = data;
+    job_id++;
+    pthread_cond_broadcast(&worker_start);
+    pthread_mutex_unlock(&worker_lock);
+
+    int first, last;
+    workersBand(0, bands, count, &first, &last);
+    func(first, last, data);
+
+    pthread_mutex_lock(&worker_lock);
+    while (job_pending > 0)
+        pthread_cond_wait(&worker_done, &worker_lock);
+    pthread_mutex_unlock(&worker_lock);
+    pthread_mutex_unlock(&worker_run_lock);
+}
+
+#else
+
+void workersInit(int count) {
+}
+
+void workersCleanup() {
+}
+
+int workersCount() {
+    return 1;
+}
+
+void workersRun(int count, int min_band, WorkerFunc func, void* data) {
+    func(0, count, data);
+}
+
+#endif
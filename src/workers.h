@@ -0,0 +1,39 @@
+/*
+    FreeBlocks -  A simple puzzle game, similar to Tetris Attack
+    Copyright (C) 2012-2017 Justin Jacobs
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef WORKERS_H
+#define WORKERS_H
+
+#include <stdbool.h>
+
+// A small pool of threads for splitting a loop over a big board into bands.
+// Each band must only write to its own part of the output, so the result is
+// the same however the work is split. Built without USE_THREADS, or before
+// workersInit(), everything runs on the calling thread. The pool is shared
+// by every board, so start and stop it from the main thread while no board
+// is running.
+#define WORKERS_MAX 16
+
+typedef void (*WorkerFunc)(int first, int last, void* data);
+
+void workersInit(int count);
+void workersCleanup();
+int workersCount();
+void workersRun(int count, int min_band, WorkerFunc func, void* data);
+
+#endif
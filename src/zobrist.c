@@ -0,0 +1,47 @@
+/*
+    FreeBlocks -  A simple puzzle game, similar to Tetris Attack
+    Copyright (C) 2012-2017 Justin Jacobs
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "zobrist.h"
+
+static uint64_t zobristMix(uint64_t x) {
+    // splitmix64
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+uint64_t zobristCell(int j, int color) {
+    // Empty cells don't change the hash. The keys are mixed on the fly
+    // rather than kept in a table, so there's nothing for boards to share.
+    if (color < 0 || color >= ZOBRIST_MAX_COLORS) return 0;
+    return zobristMix((uint64_t)j*ZOBRIST_MAX_COLORS + color);
+}
+
+uint64_t zobristRow(int i, uint64_t row_hash) {
+    // the key of a row with the given cells at row i, and empty rows don't
+    // change the hash either
+    if (row_hash == 0) return 0;
+    return zobristMix(row_hash ^ zobristMix(((uint64_t)1 << 62) | (uint32_t)i));
+}
+
+uint64_t zobristField(ZobristField field, int value) {
+    // these are few enough to mix on the fly instead of keeping tables,
+    // and the high bit keeps them apart from the cell keys
+    return zobristMix(((uint64_t)1 << 63) | ((uint64_t)field << 32) | (uint32_t)value);
+}
@@ -0,0 +1,39 @@
+/*
+    FreeBlocks -  A simple puzzle game, similar to Tetris Attack
+    Copyright (C) 2012-2017 Justin Jacobs
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ZOBRIST_H
+#define ZOBRIST_H
+
+#include <stdint.h>
+
+// Random keys for hashing board states. A row's hash is the XOR of the keys
+// of its cells, and a state's hash is the XOR of the keys of its rows and
+// everything else in it, so changing one cell only costs a few XORs.
+// The keys come from a fixed seed, so hashes match between runs.
+#define ZOBRIST_MAX_COLORS 8
+
+typedef enum {
+    ZOBRIST_CURSOR_X1, ZOBRIST_CURSOR_Y1, ZOBRIST_CURSOR_X2, ZOBRIST_CURSOR_Y2,
+    ZOBRIST_HELD_COLOR, ZOBRIST_HELD_AMOUNT
+}ZobristField;
+
+uint64_t zobristCell(int j, int color);
+uint64_t zobristRow(int i, uint64_t row_hash);
+uint64_t zobristField(ZobristField field, int value);
+
+#endif
@@ -0,0 +1,639 @@
+/*
+    FreeBlocks -  A simple puzzle game, similar to Tetris Attack
+    Copyright (C) 2012-2017 Justin Jacobs
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// freeblocks-sim: plays a batch of headless games on every core and reports
+// how they went, for tuning the speed curve and scoring without playing.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../src/block.h"
+#include "../src/ease.h"
+#include "../src/game_mode.h"
+#include "../src/rng.h"
+
+#define SIM_MAX_THREADS 256
+#define SIM_MAX_GROUPS (4*MAX_SPEED)
+
+typedef enum {
+    SIM_NONE,
+    SIM_LEFT,
+    SIM_RIGHT,
+    SIM_UP,
+    SIM_DOWN,
+    SIM_SWITCH,
+    SIM_PICKUP,
+    SIM_BUMP,
+    SIM_RANDOM
+}SimAction;
+
+// One step of a script: do action, then wait the usual think time plus wait
+typedef struct SimStep{
+    SimAction action;
+    int wait;
+}SimStep;
+
+// Every mode and speed played gets a group, and every group plays the same
+// seeds, so game n is seed first_seed + n%seed_count of group n/seed_count
+typedef struct SimGroup{
+    const GameMode *mode;
+    int speed;
+}SimGroup;
+
+typedef struct SimResult{
+    int score;
+    int frames;
+    int max_chain;
+    int end_speed;
+    bool topped_out;
+}SimResult;
+
+typedef struct SimStats{
+    long games;
+    long topped_out;
+    long long score_sum;
+    int score_min;
+    int score_max;
+    long long frames_sum;
+    int max_chain;
+}SimStats;
+
+// The games not yet started by a thread, as the range [first, last). A thread
+// takes its next game from the front of its own range, and when that runs
+// out it steals the back half of someone else's.
+typedef struct SimQueue{
+    pthread_mutex_t lock;
+    long first;
+    long last;
+}SimQueue;
+
+typedef struct SimThread{
+    pthread_t thread;
+    int index;
+    SimStats *stats;
+}SimThread;
+
+static const char *sim_mode_names[] = { "default", "jewels", "drop", "marathon" };
+
+static SimGroup sim_groups[SIM_MAX_GROUPS];
+static int sim_group_count = 0;
+static uint64_t sim_first_seed = 1;
+static long sim_seed_count = 1000;
+static long sim_games = 0;
+
+static int sim_think = 10;
+static int sim_max_frames = 20*60*FPS;
+static bool sim_instant = false;
+static SimStep *sim_script = NULL;
+static int sim_script_length = 0;
+
+static int sim_threads = 0;
+static SimQueue sim_queues[SIM_MAX_THREADS];
+
+// only kept when every game is written out, since that's one per game
+static SimResult *sim_results = NULL;
+
+static void simUsage() {
+    fprintf(stderr,
+        "Usage: freeblocks-sim [options]\n"
+        "  --modes LIST      default,jewels,drop,marathon or all (default: default)\n"
+        "  --speeds A[-B]    speed levels, for the modes that have them (default: 1)\n"
+        "  --seeds A[-B]     game seeds (default: 1-1000)\n"
+        "  --script FILE     play the actions in FILE instead of random ones\n"
+        "  --think N         frames between actions (default: 10)\n"
+        "  --minutes N       stop a game that lasts this long (default: 20)\n"
+        "  --instant         resolve matches in the frame they happen\n"
+        "  --threads N       threads to play on (default: one per processor)\n"
+        "  --format csv|json (default: csv)\n"
+        "  --games           write every game rather than the totals\n"
+        "  --output FILE     write to FILE instead of stdout\n");
+}
+
+static bool simParseRange(const char *arg, long long *first, long long *last) {
+    char *end;
+    *first = strtoll(arg, &end, 10);
+    if (end == arg) return false;
+    *last = *first;
+    if (*end == '-') {
+        const char *second = end+1;
+        *last = strtoll(second, &end, 10);
+        if (end == second) return false;
+    }
+    return *end == '\0' && *last >= *first;
+}
+
+static const GameMode* simModeByName(const char *name, size_t length) {
+    const GameMode *modes[] = { &game_mode_default, &game_mode_jewels, &game_mode_drop, &game_mode_marathon };
+    for (int n=0; n<4; n++) {
+        if (strlen(sim_mode_names[n]) == length && strncmp(sim_mode_names[n], name, length) == 0)
+            return modes[n];
+    }
+    return NULL;
+}
+
+static bool simAddGroups(const char *modes, int speed_first, int speed_last) {
+    if (strcmp(modes, "all") == 0)
+        modes = "default,jewels,drop,marathon";
+
+    const char *name = modes;
+    while (true) {
+        size_t length = strcspn(name, ",");
+        const GameMode *mode = simModeByName(name, length);
+        if (!mode) {
+            fprintf(stderr, "Unknown mode: %.*s\n", (int)length, name);
+            return false;
+        }
+
+        // modes without a speed setting only need playing once
+        int last = mode->speed ? speed_last : speed_first;
+        for (int speed=speed_first; speed<=last; speed++) {
+            if (sim_group_count == SIM_MAX_GROUPS) {
+                fprintf(stderr, "Too many modes and speeds\n");
+                return false;
+            }
+            sim_groups[sim_group_count].mode = mode;
+            sim_groups[sim_group_count].speed = speed;
+            sim_group_count++;
+        }
+
+        if (name[length] == '\0') break;
+        name += length+1;
+    }
+    return true;
+}
+
+static bool simLoadScript(const char *path) {
+    // Whitespace separated actions: left, right, up, down, switch, pickup,
+    // bump, random, or "wait N" to add N frames before the next one.
+    // Anything after a # is a comment. The script repeats until the game ends.
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        fprintf(stderr, "Couldn't open script: %s\n", path);
+        return false;
+    }
+
+    const char *names[] = { "none", "left", "right", "up", "down", "switch", "pickup", "bump", "random" };
+    int capacity = 0;
+    char token[64];
+    bool ok = true;
+
+    while (ok && fscanf(file, "%63s", token) == 1) {
+        if (token[0] == '#') {
+            int c;
+            while ((c = fgetc(file)) != EOF && c != '\n');
+            continue;
+        }
+
+        if (strcmp(token, "wait") == 0) {
+            int wait;
+            if (sim_script_length == 0 || fscanf(file, "%d", &wait) != 1 || wait < 0) {
+                fprintf(stderr, "%s: \"wait\" needs a number of frames after an action\n", path);
+                ok = false;
+            }
+            else {
+                sim_script[sim_script_length-1].wait += wait;
+            }
+            continue;
+        }
+
+        SimAction action = SIM_NONE;
+        for (int n=SIM_LEFT; n<=SIM_RANDOM; n++) {
+            if (strcmp(token, names[n]) == 0)
+                action = n;
+        }
+        if (action == SIM_NONE) {
+            fprintf(stderr, "%s: unknown action \"%s\"\n", path, token);
+            ok = false;
+            break;
+        }
+
+        if (sim_script_length == capacity) {
+            capacity = capacity ? capacity*2 : 64;
+            sim_script = realloc(sim_script, sizeof(SimStep)*capacity);
+        }
+        sim_script[sim_script_length].action = action;
+        sim_script[sim_script_length].wait = 0;
+        sim_script_length++;
+    }
+    fclose(file);
+
+    if (ok && sim_script_length == 0) {
+        fprintf(stderr, "%s: no actions\n", path);
+        ok = false;
+    }
+    return ok;
+}
+
+static void simMove(Board *board, int dx, int dy) {
+    // what gameMove() does with a direction key
+    if (board->cursor.y1 < board->cursor_min_y) board->cursor.y1 = board->cursor_min_y;
+
+    int x = board->cursor.x1 + dx;
+    int y = board->cursor.y1 + dy;
+    if (x >= 0 && x <= board->cursor_max_x && y >= board->cursor_min_y && y <= board->cursor_max_y) {
+        if (board->mode == &game_mode_jewels && board->jewels_cursor_select) {
+            board->cursor.x2 = x;
+            board->cursor.y2 = y;
+            board->mode->doSwitch(board);
+        }
+        else {
+            board->cursor.x1 = x;
+            board->cursor.y1 = y;
+        }
+    }
+
+    board->mode->setCursor(board);
+}
+
+static void simAct(Board *board, Rng *rng, SimAction action) {
+    if (action == SIM_RANDOM) {
+        // about what a button masher does: mostly moving and switching,
+        // and bumping now and then
+        int roll = rngRange(rng, 64);
+        if (roll < 16) action = SIM_LEFT + roll/4;
+        else if (roll < 36) action = SIM_SWITCH;
+        else if (roll < 40) action = SIM_PICKUP;
+        else if (roll < 41) action = SIM_BUMP;
+        else action = SIM_NONE;
+    }
+
+    switch (action) {
+    case SIM_LEFT: simMove(board, -1, 0); break;
+    case SIM_RIGHT: simMove(board, 1, 0); break;
+    case SIM_UP: simMove(board, 0, -1); break;
+    case SIM_DOWN: simMove(board, 0, 1); break;
+    case SIM_SWITCH: board->mode->doSwitch(board); break;
+    case SIM_PICKUP: board->mode->pickUp(board); break;
+    case SIM_BUMP: board->mode->bump(board); break;
+    default: break;
+    }
+}
+
+static void simPlay(long game, SimResult *result) {
+    const SimGroup *group = &sim_groups[game / sim_seed_count];
+    uint64_t seed = sim_first_seed + (uint64_t)(game % sim_seed_count);
+
+    Board board;
+    memset(&board, 0, sizeof(board));
+    board.mode = group->mode;
+    board.seed = seed;
+    board.speed_init = group->speed;
+    board.instant_resolve = sim_instant;
+    blockInitAll(&board);
+
+    // the same start as gameInit()
+    board.cursor.x1 = (board.cols/2)-1;
+    board.cursor.y1 = board.rows-board.start_rows;
+    if (board.cursor.y1 > board.cursor_max_y) board.cursor.y1 = board.cursor_max_y;
+    board.mode->setCursor(&board);
+
+    // random actions come from their own generator, so they don't change
+    // which blocks the board deals
+    Rng rng;
+    rngSeed(&rng, seed ^ 0x5851f42d4c957f2dULL);
+
+    int frames = 0;
+    int next_action = sim_think;
+    int step = 0;
+    int max_chain = 0;
+
+    while (board.game_over_timer == 0 && frames < sim_max_frames) {
+        // nothing happens between actions on a board that's only waiting for
+        // its timers, so those frames go by in one step
+        int skip = min(blockIdleFrames(&board), next_action - frames);
+        skip = min(skip, sim_max_frames - frames);
+        if (skip > 0) {
+            blockSkipFrames(&board, skip);
+            frames += skip;
+            continue;
+        }
+
+        // then the input, in the same order as gameLogic()
+        blockLogic(&board);
+        if (board.chain_count > max_chain) max_chain = board.chain_count;
+
+        if (frames == next_action) {
+            if (sim_script) {
+                simAct(&board, &rng, sim_script[step].action);
+                next_action += sim_script[step].wait;
+                step = (step+1) % sim_script_length;
+            }
+            else {
+                simAct(&board, &rng, SIM_RANDOM);
+            }
+            next_action += sim_think;
+        }
+        frames++;
+    }
+
+    result->score = board.score;
+    result->frames = frames;
+    result->max_chain = max_chain;
+    result->end_speed = board.speed;
+    result->topped_out = board.game_over_timer > 0;
+
+    blockCleanup(&board);
+}
+
+static void simAddStats(SimStats *stats, const SimResult *result) {
+    if (stats->games == 0 || result->score < stats->score_min) stats->score_min = result->score;
+    if (stats->games == 0 || result->score > stats->score_max) stats->score_max = result->score;
+    stats->games++;
+    stats->topped_out += result->topped_out;
+    stats->score_sum += result->score;
+    stats->frames_sum += result->frames;
+    stats->max_chain = max(stats->max_chain, result->max_chain);
+}
+
+static void simMergeStats(SimStats *stats, const SimStats *other) {
+    if (other->games == 0) return;
+    if (stats->games == 0 || other->score_min < stats->score_min) stats->score_min = other->score_min;
+    if (stats->games == 0 || other->score_max > stats->score_max) stats->score_max = other->score_max;
+    stats->games += other->games;
+    stats->topped_out += other->topped_out;
+    stats->score_sum += other->score_sum;
+    stats->frames_sum += other->frames_sum;
+    stats->max_chain = max(stats->max_chain, other->max_chain);
+}
+
+static bool simTake(SimQueue *queue, long *game) {
+    bool taken = false;
+    pthread_mutex_lock(&queue->lock);
+    if (queue->first < queue->last) {
+        *game = queue->first++;
+        taken = true;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return taken;
+}
+
+static bool simSteal(int self, long *game) {
+    // Only called once our own queue is empty. The victims are tried in turn
+    // from the next thread on, and the back half of the first one with work
+    // left becomes ours.
+    for (int n=1; n<sim_threads; n++) {
+        SimQueue *victim = &sim_queues[(self+n) % sim_threads];
+        long first = 0, last = 0;
+
+        pthread_mutex_lock(&victim->lock);
+        long left = victim->last - victim->first;
+        if (left > 0) {
+            last = victim->last;
+            first = last - (left+1)/2;
+            victim->last = first;
+        }
+        pthread_mutex_unlock(&victim->lock);
+
+        if (first < last) {
+            SimQueue *own = &sim_queues[self];
+            pthread_mutex_lock(&own->lock);
+            own->first = first+1;
+            own->last = last;
+            pthread_mutex_unlock(&own->lock);
+            *game = first;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void* simThreadMain(void *arg) {
+    SimThread *thread = arg;
+    long game;
+
+    while (simTake(&sim_queues[thread->index], &game) || simSteal(thread->index, &game)) {
+        SimResult result;
+        simPlay(game, &result);
+        simAddStats(&thread->stats[game / sim_seed_count], &result);
+        if (sim_results)
+            sim_results[game] = result;
+    }
+    return NULL;
+}
+
+static void simWriteGames(FILE *out, bool json) {
+    if (json) fprintf(out, "[\n");
+    else fprintf(out, "mode,speed,seed,score,frames,seconds,topped_out,max_chain,end_speed\n");
+
+    for (long game=0; game<sim_games; game++) {
+        const SimGroup *group = &sim_groups[game / sim_seed_count];
+        const SimResult *r = &sim_results[game];
+        const char *mode = sim_mode_names[gameModeGetIndex(group->mode)];
+        unsigned long long seed = sim_first_seed + (unsigned long long)(game % sim_seed_count);
+        double seconds = (double)r->frames / FPS;
+
+        if (json) {
+            fprintf(out, "  {\"mode\": \"%s\", \"speed\": %d, \"seed\": %llu, \"score\": %d, \"frames\": %d, \"seconds\": %.2f, \"topped_out\": %s, \"max_chain\": %d, \"end_speed\": %d}%s\n",
+                mode, group->speed, seed, r->score, r->frames, seconds, r->topped_out ? "true" : "false", r->max_chain, r->end_speed, game+1 < sim_games ? "," : "");
+        }
+        else {
+            fprintf(out, "%s,%d,%llu,%d,%d,%.2f,%d,%d,%d\n",
+                mode, group->speed, seed, r->score, r->frames, seconds, r->topped_out, r->max_chain, r->end_speed);
+        }
+    }
+
+    if (json) fprintf(out, "]\n");
+}
+
+static void simWriteStats(FILE *out, bool json, const SimStats *stats) {
+    if (json) fprintf(out, "[\n");
+    else fprintf(out, "mode,speed,games,topped_out,topout_rate,score_mean,score_min,score_max,seconds_mean,max_chain\n");
+
+    for (int n=0; n<sim_group_count; n++) {
+        const SimGroup *group = &sim_groups[n];
+        const SimStats *s = &stats[n];
+        const char *mode = sim_mode_names[gameModeGetIndex(group->mode)];
+        double rate = (double)s->topped_out / s->games;
+        double score = (double)s->score_sum / s->games;
+        double seconds = (double)s->frames_sum / s->games / FPS;
+
+        if (json) {
+            fprintf(out, "  {\"mode\": \"%s\", \"speed\": %d, \"games\": %ld, \"topped_out\": %ld, \"topout_rate\": %.4f, \"score_mean\": %.2f, \"score_min\": %d, \"score_max\": %d, \"seconds_mean\": %.2f, \"max_chain\": %d}%s\n",
+                mode, group->speed, s->games, s->topped_out, rate, score, s->score_min, s->score_max, seconds, s->max_chain, n+1 < sim_group_count ? "," : "");
+        }
+        else {
+            fprintf(out, "%s,%d,%ld,%ld,%.4f,%.2f,%d,%d,%.2f,%d\n",
+                mode, group->speed, s->games, s->topped_out, rate, score, s->score_min, s->score_max, seconds, s->max_chain);
+        }
+    }
+
+    if (json) fprintf(out, "]\n");
+}
+
+static double simTime() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[]) {
+    const char *modes = "default";
+    const char *output = NULL;
+    long long speed_first = 1, speed_last = 1;
+    long long seed_first = 1, seed_last = 1000;
+    bool json = false;
+    bool per_game = false;
+
+    easeInit();
+
+    for (int n=1; n<argc; n++) {
+        const char *arg = argv[n];
+        const char *value = n+1 < argc ? argv[n+1] : NULL;
+        bool ok = true;
+
+        if (strcmp(arg, "--instant") == 0) {
+            sim_instant = true;
+            continue;
+        }
+        else if (strcmp(arg, "--games") == 0) {
+            per_game = true;
+            continue;
+        }
+        else if (strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0) {
+            simUsage();
+            return 0;
+        }
+
+        // everything else takes a value
+        if (!value) {
+            ok = false;
+        }
+        else if (strcmp(arg, "--modes") == 0) {
+            modes = value;
+        }
+        else if (strcmp(arg, "--speeds") == 0) {
+            ok = simParseRange(value, &speed_first, &speed_last) && speed_first >= 1 && speed_last <= MAX_SPEED;
+        }
+        else if (strcmp(arg, "--seeds") == 0) {
+            ok = simParseRange(value, &seed_first, &seed_last) && seed_first >= 0;
+        }
+        else if (strcmp(arg, "--script") == 0) {
+            if (!simLoadScript(value)) return 1;
+        }
+        else if (strcmp(arg, "--think") == 0) {
+            sim_think = atoi(value);
+            ok = sim_think >= 1;
+        }
+        else if (strcmp(arg, "--minutes") == 0) {
+            int minutes = atoi(value);
+            ok = minutes >= 1 && minutes <= 24*60;
+            sim_max_frames = minutes*60*FPS;
+        }
+        else if (strcmp(arg, "--threads") == 0) {
+            sim_threads = atoi(value);
+            ok = sim_threads >= 1;
+        }
+        else if (strcmp(arg, "--format") == 0) {
+            json = strcmp(value, "json") == 0;
+            ok = json || strcmp(value, "csv") == 0;
+        }
+        else if (strcmp(arg, "--output") == 0) {
+            output = value;
+        }
+        else {
+            ok = false;
+        }
+
+        if (!ok) {
+            fprintf(stderr, "Bad option: %s%s%s\n", arg, value ? " " : "", value ? value : "");
+            simUsage();
+            return 1;
+        }
+        n++;
+    }
+
+    if (!simAddGroups(modes, (int)speed_first, (int)speed_last)) return 1;
+    sim_first_seed = (uint64_t)seed_first;
+    sim_seed_count = (long)(seed_last - seed_first + 1);
+    sim_games = sim_group_count * sim_seed_count;
+
+    if (sim_threads <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        sim_threads = cpus > 0 ? (int)cpus : 1;
+    }
+    if (sim_threads > SIM_MAX_THREADS) sim_threads = SIM_MAX_THREADS;
+    if (sim_threads > sim_games) sim_threads = (int)sim_games;
+
+    if (per_game) {
+        sim_results = malloc(sizeof(SimResult)*sim_games);
+        if (!sim_results) {
+            fprintf(stderr, "Not enough memory to keep %ld games, try without --games\n", sim_games);
+            return 1;
+        }
+    }
+
+    FILE *out = stdout;
+    if (output) {
+        out = fopen(output, "w");
+        if (!out) {
+            fprintf(stderr, "Couldn't open output: %s\n", output);
+            return 1;
+        }
+    }
+
+    // every thread starts with an even share, and keeps its own totals so
+    // they never have to share a lock for them
+    SimThread *threads = calloc(sim_threads, sizeof(SimThread));
+    for (int n=0; n<sim_threads; n++) {
+        pthread_mutex_init(&sim_queues[n].lock, NULL);
+        sim_queues[n].first = (long)((long long)sim_games * n / sim_threads);
+        sim_queues[n].last = (long)((long long)sim_games * (n+1) / sim_threads);
+        threads[n].index = n;
+        threads[n].stats = calloc(sim_group_count, sizeof(SimStats));
+    }
+
+    double start = simTime();
+
+    // thread 0 is this one
+    for (int n=1; n<sim_threads; n++)
+        pthread_create(&threads[n].thread, NULL, simThreadMain, &threads[n]);
+    simThreadMain(&threads[0]);
+    for (int n=1; n<sim_threads; n++)
+        pthread_join(threads[n].thread, NULL);
+
+    double elapsed = simTime() - start;
+
+    // the totals don't depend on which thread played what
+    SimStats *stats = calloc(sim_group_count, sizeof(SimStats));
+    for (int n=0; n<sim_threads; n++) {
+        for (int g=0; g<sim_group_count; g++)
+            simMergeStats(&stats[g], &threads[n].stats[g]);
+        free(threads[n].stats);
+        pthread_mutex_destroy(&sim_queues[n].lock);
+    }
+
+    if (per_game) simWriteGames(out, json);
+    else simWriteStats(out, json, stats);
+
+    if (out != stdout) fclose(out);
+
+    fprintf(stderr, "%ld games in %.1fs on %d threads, %.0f games/s\n",
+        sim_games, elapsed, sim_threads, elapsed > 0 ? sim_games / elapsed : 0.0);
+
+    free(stats);
+    free(threads);
+    free(sim_results);
+    free(sim_script);
+    return 0;
+}